@@ -0,0 +1,191 @@
+#include "nesInstance.hpp"
+#include "core/apu/blipBuffer.hpp"
+#include "core/deferredSound.hpp"
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/file.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <jaffarCommon/string.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Measures sound synthesis on a test sequence: the sequence is played with sound enabled, reading
+// the samples after every frame, once with the vectorized Blip_Buffer loops and once with the scalar
+// ones, and once headless with the sound synthesized on another thread from the logged APU events.
+// All three must produce the same samples.
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("audioTester", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("--rate")
+    .help("Output sample rate.")
+    .default_value(std::string("44100"));
+
+  // Try to parse arguments
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str());
+  }
+
+  // Getting test script file path
+  std::string scriptFilePath = program.get<std::string>("scriptFile");
+
+  // Getting sample rate
+  const long sampleRate = std::stol(program.get<std::string>("--rate"));
+  if (sampleRate < 1) JAFFAR_THROW_LOGIC("Sample rate must be positive\n");
+
+  // Loading script file
+  std::string scriptJsonRaw;
+  if (jaffarCommon::file::loadStringFromFile(scriptJsonRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+
+  // Parsing script
+  const auto scriptJson = nlohmann::json::parse(scriptJsonRaw);
+
+  // Getting rom, initial state and sequence file paths
+  if (scriptJson.contains("Rom File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Rom File' entry\n");
+  if (scriptJson.contains("Initial State File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Initial State File' entry\n");
+  if (scriptJson.contains("Sequence File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Sequence File' entry\n");
+  std::string romFilePath = scriptJson["Rom File"].get<std::string>();
+  std::string initialStateFilePath = scriptJson["Initial State File"].get<std::string>();
+  std::string sequenceFilePath = scriptJson["Sequence File"].get<std::string>();
+
+  // Loading ROM
+  std::string romFileData;
+  if (jaffarCommon::file::loadStringFromFile(romFileData, romFilePath) == false) JAFFAR_THROW_LOGIC("Could not rom file: %s\n", romFilePath.c_str());
+
+  // Creating the emulating instance and the deferred sound output
+  std::vector<std::unique_ptr<NESInstance>> instances;
+  for (size_t i = 0; i < 2; i++)
+  {
+    instances.push_back(std::make_unique<NESInstance>(scriptJson));
+    if (i == 0 || instances[i]->shareROM(*instances[0]) == false) instances[i]->loadROM((uint8_t *)romFileData.data(), romFileData.size());
+  }
+  auto &e = *instances[0];
+  auto emulator = (quickerNES::Emu *)instances[0]->getInternalEmulatorPointer();
+  auto output = (quickerNES::Emu *)instances[1]->getInternalEmulatorPointer();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, '\n');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+  const size_t sequenceLength = decodedSequence.size();
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", sequenceLength);
+  printf("[] Sample Rate:                            %ld\n", sampleRate);
+  printf("[] ********** Running Test **********\n");
+  fflush(stdout);
+
+  // Sound is only produced for frames rendered into a video buffer
+  std::vector<uint8_t> videoBuffer(quickerNES::Emu::buffer_width * emulator->buffer_height());
+  emulator->set_pixels(videoBuffer.data(), quickerNES::Emu::buffer_width);
+
+  // Both runs start from the same state, with an empty sound buffer
+  const size_t stateSize = e.getFullStateSize();
+  std::vector<uint8_t> initialState(stateSize);
+  jaffarCommon::serializer::Contiguous s(initialState.data(), stateSize);
+  e.serializeState(s);
+
+  std::vector<short> sampleBuffer(4096);
+  size_t sampleCount[2] = {0, 0};
+  double seconds[2] = {0.0, 0.0};
+  jaffarCommon::hash::hash_t sampleHash[2];
+  for (int simd = 1; simd >= 0; simd--)
+  {
+    emulator->set_simd_sound(simd == 1);
+    jaffarCommon::deserializer::Contiguous d(initialState.data(), stateSize);
+    e.deserializeState(d);
+    const char *error = emulator->set_sample_rate(sampleRate);
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not set sample rate: %s\n", error);
+
+    std::vector<short> samples;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < sequenceLength; i++)
+    {
+      emulator->emulate_frame(decodedSequence[i].port1, decodedSequence[i].port2, 0, 0);
+      long count = emulator->read_samples(sampleBuffer.data(), sampleBuffer.size());
+      samples.insert(samples.end(), sampleBuffer.begin(), sampleBuffer.begin() + count);
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    seconds[simd] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+    sampleCount[simd] = samples.size();
+    sampleHash[simd] = jaffarCommon::hash::calculateMetroHash(samples.data(), samples.size() * sizeof(short));
+  }
+
+  if (sampleCount[0] != sampleCount[1] || sampleHash[0] != sampleHash[1]) JAFFAR_THROW_LOGIC("[ERROR] Vectorized sound synthesis differs from the scalar one\n");
+
+  // Deferred synthesis: the source runs headless, and samples are collected as they come out
+  {
+    jaffarCommon::deserializer::Contiguous d(initialState.data(), stateSize);
+    e.deserializeState(d);
+  }
+  const char *error = output->set_sample_rate(sampleRate);
+  if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not set sample rate: %s\n", error);
+
+  std::vector<short> deferredSamples;
+  auto t0 = std::chrono::high_resolution_clock::now();
+  quickerNES::Deferred_Sound sound;
+  error = sound.init(emulator, output);
+  if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not start deferred sound: %s\n", error);
+  // Read in small pieces, so that reads leave samples behind while the worker adds more
+  auto collectSamples = [&]()
+  {
+    long count;
+    do
+    {
+      count = sound.read_samples(sampleBuffer.data(), 256);
+      deferredSamples.insert(deferredSamples.end(), sampleBuffer.begin(), sampleBuffer.begin() + count);
+    } while (count > 0);
+  };
+  for (size_t i = 0; i < sequenceLength; i++)
+  {
+    emulator->emulate_skip_frame(decodedSequence[i].port1, decodedSequence[i].port2, 0, 0);
+    error = sound.end_frame();
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Deferred synthesis failed (frame %lu): %s\n", i, error);
+    collectSamples();
+  }
+  error = sound.wait();
+  if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Deferred synthesis failed: %s\n", error);
+  while (sound.samples_avail() > 0) collectSamples();
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  const double deferredSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+  const auto deferredHash = jaffarCommon::hash::calculateMetroHash(deferredSamples.data(), deferredSamples.size() * sizeof(short));
+  if (deferredSamples.size() != sampleCount[1] || deferredHash != sampleHash[1]) JAFFAR_THROW_LOGIC("[ERROR] Deferred sound synthesis differs from the direct one\n");
+
+  // Reporting
+  printf("[] Samples Produced:                       %lu\n", sampleCount[1]);
+  printf("[] Scalar Performance:                     %.3f samples / s\n", (double)sampleCount[0] / seconds[0]);
+  printf("[] SIMD Performance:                       %.3f samples / s (%.3fx)\n", (double)sampleCount[1] / seconds[1], seconds[0] / seconds[1]);
+  printf("[] Deferred Performance:                   %.3f samples / s (%.3fx)\n", (double)deferredSamples.size() / deferredSeconds, seconds[1] / deferredSeconds);
+  printf("[] Sample Hash:                            0x%lX%lX\n", sampleHash[1].first, sampleHash[1].second);
+
+  // If reached this point, everything ran ok
+  return 0;
+}
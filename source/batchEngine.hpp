@@ -0,0 +1,242 @@
+#pragma once
+
+// Batch emulation engine: multi-threaded (parent state, input) -> child state expansion
+
+#include "inputParser.hpp"
+#include "nesInstanceBase.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Owns a pool of worker threads, each with its own emulator instance. All instances share the ROM
+// loaded by the first one when the core supports it. Batches of jobs are split evenly among the
+// workers; a worker that runs out of jobs steals half of the remaining range of another worker.
+//
+// Everything a worker touches in the hot path (instance, scratch state, job range) is allocated
+// up front and kept in its own cache lines, so running a batch never calls malloc.
+template <class instance_t>
+class BatchEngine
+{
+  public:
+  struct job_t
+  {
+    const uint8_t *parentState;
+    jaffar::input_t input;
+  };
+
+  // The setup function is applied to every instance after loading the ROM (state blocks, rendering, code map)
+  BatchEngine(const nlohmann::json &config, const uint8_t *romData, const size_t romSize, const size_t threadCount, const std::function<void(NESInstanceBase &)> &setup)
+    : _workerCount(threadCount)
+  {
+    if (_workerCount == 0) JAFFAR_THROW_LOGIC("Batch engine requires at least one thread\n");
+
+    _workers = std::make_unique<worker_t[]>(_workerCount);
+    for (size_t i = 0; i < _workerCount; i++)
+    {
+      auto &worker = _workers[i];
+      worker.instance = std::make_unique<instance_t>(config);
+
+      // Only the first instance parses the ROM, unless the core cannot share it
+      bool loaded = i > 0 && worker.instance->shareROM(*_workers[0].instance);
+      if (loaded == false) loaded = worker.instance->loadROM(romData, romSize);
+      if (loaded == false) JAFFAR_THROW_LOGIC("Batch engine could not load the ROM\n");
+
+      setup(*worker.instance);
+    }
+
+    _stateSize = _workers[0].instance->getFullStateSize();
+    for (size_t i = 0; i < _workerCount; i++) _workers[i].scratch.resize(_stateSize);
+
+    // Worker 0 is the calling thread
+    for (size_t i = 1; i < _workerCount; i++) _threads.emplace_back([this, i]() { workerLoop(i); });
+  }
+
+  ~BatchEngine()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _exit = true;
+    }
+    _startCondition.notify_all();
+    for (auto &thread : _threads) thread.join();
+  }
+
+  // Runs all jobs. Child states are written to childStates[i * getStateSize()] and their hashes to
+  // childHashes[i]. Either output can be null if not needed.
+  void run(const job_t *jobs, const size_t jobCount, uint8_t *childStates, jaffarCommon::hash::hash_t *childHashes)
+  {
+    // Splitting the batch evenly among workers
+    for (size_t i = 0; i < _workerCount; i++)
+    {
+      const size_t begin = jobCount * i / _workerCount;
+      const size_t end = jobCount * (i + 1) / _workerCount;
+      _workers[i].range.store(packRange(begin, end));
+      _workers[i].jobCount = 0;
+      _workers[i].stealCount = 0;
+    }
+
+    _jobs = jobs;
+    _childStates = childStates;
+    _childHashes = childHashes;
+    _pendingWorkers.store(_workerCount - 1);
+
+    // Waking up the pool
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _generation++;
+    }
+    _startCondition.notify_all();
+
+    // The calling thread works too
+    processJobs(0);
+
+    // Waiting for the rest of the workers to finish
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this]() { return _pendingWorkers.load() == 0; });
+  }
+
+  inline size_t getStateSize() const { return _stateSize; }
+  inline size_t getThreadCount() const { return _workerCount; }
+  inline NESInstanceBase &getInstance(const size_t thread) { return *_workers[thread].instance; }
+
+  // Statistics of the last batch
+  inline size_t getJobCount(const size_t thread) const { return _workers[thread].jobCount; }
+  inline size_t getStealCount(const size_t thread) const { return _workers[thread].stealCount; }
+
+  private:
+  struct alignas(64) worker_t
+  {
+    std::unique_ptr<instance_t> instance;
+    std::vector<uint8_t> scratch;
+
+    // Remaining job range, packed as [begin, end) in the low and high 32 bits
+    std::atomic<uint64_t> range;
+
+    size_t jobCount;
+    size_t stealCount;
+  };
+
+  static inline uint64_t packRange(const uint64_t begin, const uint64_t end) { return begin | (end << 32); }
+  static inline uint32_t rangeBegin(const uint64_t range) { return (uint32_t)range; }
+  static inline uint32_t rangeEnd(const uint64_t range) { return (uint32_t)(range >> 32); }
+
+  void workerLoop(const size_t workerId)
+  {
+    size_t generation = 0;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _startCondition.wait(lock, [&]() { return _exit || _generation != generation; });
+        if (_exit) return;
+        generation = _generation;
+      }
+
+      processJobs(workerId);
+
+      if (_pendingWorkers.fetch_sub(1) == 1)
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _doneCondition.notify_all();
+      }
+    }
+  }
+
+  void processJobs(const size_t workerId)
+  {
+    auto &worker = _workers[workerId];
+
+    while (true)
+    {
+      // Taking the next job from the front of the own range
+      uint64_t range = worker.range.load();
+      while (rangeBegin(range) < rangeEnd(range))
+      {
+        if (worker.range.compare_exchange_weak(range, packRange(rangeBegin(range) + 1, rangeEnd(range))) == false) continue;
+        runJob(worker, rangeBegin(range));
+        range = worker.range.load();
+      }
+
+      // Own range exhausted, stealing from others
+      if (steal(workerId) == false) return;
+    }
+  }
+
+  // Moves the back half of the largest remaining range into the worker's own range
+  bool steal(const size_t workerId)
+  {
+    while (true)
+    {
+      size_t victimId = workerId;
+      uint32_t victimRemaining = 0;
+      for (size_t i = 0; i < _workerCount; i++)
+      {
+        const auto range = _workers[i].range.load();
+        const uint32_t remaining = rangeEnd(range) > rangeBegin(range) ? rangeEnd(range) - rangeBegin(range) : 0;
+        if (i != workerId && remaining > victimRemaining)
+        {
+          victimId = i;
+          victimRemaining = remaining;
+        }
+      }
+      if (victimRemaining == 0) return false;
+
+      auto &victim = _workers[victimId];
+      uint64_t range = victim.range.load();
+      const uint32_t begin = rangeBegin(range);
+      const uint32_t end = rangeEnd(range);
+      if (begin >= end) continue;
+
+      const uint32_t split = end - (end - begin + 1) / 2;
+      if (victim.range.compare_exchange_strong(range, packRange(begin, split)) == false) continue;
+
+      _workers[workerId].range.store(packRange(split, end));
+      _workers[workerId].stealCount++;
+      return true;
+    }
+  }
+
+  inline void runJob(worker_t &worker, const size_t jobId)
+  {
+    const auto &job = _jobs[jobId];
+    auto &instance = *worker.instance;
+
+    jaffarCommon::deserializer::Contiguous d(job.parentState, _stateSize);
+    instance.deserializeState(d);
+
+    instance.advanceState(job.input);
+
+    uint8_t *childState = _childStates != nullptr ? &_childStates[jobId * _stateSize] : worker.scratch.data();
+    jaffarCommon::serializer::Contiguous s(childState, _stateSize);
+    instance.serializeState(s);
+
+    if (_childHashes != nullptr) _childHashes[jobId] = jaffarCommon::hash::calculateMetroHash(childState, _stateSize);
+
+    worker.jobCount++;
+  }
+
+  const size_t _workerCount;
+  size_t _stateSize;
+  std::unique_ptr<worker_t[]> _workers;
+  std::vector<std::thread> _threads;
+
+  // Current batch
+  const job_t *_jobs = nullptr;
+  uint8_t *_childStates = nullptr;
+  jaffarCommon::hash::hash_t *_childHashes = nullptr;
+
+  // Pool synchronization
+  std::mutex _mutex;
+  std::condition_variable _startCondition;
+  std::condition_variable _doneCondition;
+  size_t _generation = 0;
+  bool _exit = false;
+  std::atomic<size_t> _pendingWorkers = 0;
+};
@@ -0,0 +1,226 @@
+#include "nesInstance.hpp"
+#include "core/deferredRenderer.hpp"
+#include <algorithm>
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/file.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <jaffarCommon/string.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Measures deferred rendering on a test sequence: the sequence is played once rendering every frame
+// directly, and once emulating headless while a worker thread renders the frames from the PPU event
+// log. Both must produce the same frames, and so must frames rendered again from the log history.
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("deferredRenderTester", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("--keyframeInterval")
+    .help("Number of frames between the states kept for rendering logged frames again.")
+    .default_value(std::string("60"));
+
+  program.add_argument("--history")
+    .help("Number of logged frames kept for rendering again, the oldest being recycled first. Zero keeps the whole sequence.")
+    .default_value(std::string("0"));
+
+  program.add_argument("--stride")
+    .help("Renders every n-th logged frame again from the history.")
+    .default_value(std::string("7"));
+
+  // Try to parse arguments
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str());
+  }
+
+  // Getting test script file path
+  std::string scriptFilePath = program.get<std::string>("scriptFile");
+
+  // Getting keyframe interval, history size and stride
+  const int keyframeInterval = std::stoi(program.get<std::string>("--keyframeInterval"));
+  const int historySize = std::stoi(program.get<std::string>("--history"));
+  const size_t stride = std::stoul(program.get<std::string>("--stride"));
+  if (keyframeInterval < 1) JAFFAR_THROW_LOGIC("Keyframe interval must be at least 1\n");
+  if (historySize < 0) JAFFAR_THROW_LOGIC("History size must not be negative\n");
+  if (stride < 1) JAFFAR_THROW_LOGIC("Stride must be at least 1\n");
+
+  // Loading script file
+  std::string scriptJsonRaw;
+  if (jaffarCommon::file::loadStringFromFile(scriptJsonRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+
+  // Parsing script
+  const auto scriptJson = nlohmann::json::parse(scriptJsonRaw);
+
+  // Getting rom, initial state and sequence file paths
+  if (scriptJson.contains("Rom File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Rom File' entry\n");
+  if (scriptJson.contains("Initial State File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Initial State File' entry\n");
+  if (scriptJson.contains("Sequence File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Sequence File' entry\n");
+  std::string romFilePath = scriptJson["Rom File"].get<std::string>();
+  std::string initialStateFilePath = scriptJson["Initial State File"].get<std::string>();
+  std::string sequenceFilePath = scriptJson["Sequence File"].get<std::string>();
+
+  // Loading ROM
+  std::string romFileData;
+  if (jaffarCommon::file::loadStringFromFile(romFileData, romFilePath) == false) JAFFAR_THROW_LOGIC("Could not rom file: %s\n", romFilePath.c_str());
+
+  // Creating the emulating instance, the deferred renderer's output and an instance for rendering frames again
+  std::vector<std::unique_ptr<NESInstance>> instances;
+  for (size_t i = 0; i < 3; i++)
+  {
+    instances.push_back(std::make_unique<NESInstance>(scriptJson));
+    if (i == 0 || instances[i]->shareROM(*instances[0]) == false) instances[i]->loadROM((uint8_t *)romFileData.data(), romFileData.size());
+  }
+  auto &e = *instances[0];
+  auto source = (quickerNES::Emu *)instances[0]->getInternalEmulatorPointer();
+  auto output = (quickerNES::Emu *)instances[1]->getInternalEmulatorPointer();
+  auto again = (quickerNES::Emu *)instances[2]->getInternalEmulatorPointer();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  const size_t stateSize = e.getFullStateSize();
+  std::vector<uint8_t> initialState(stateSize);
+  {
+    jaffarCommon::serializer::Contiguous s(initialState.data(), stateSize);
+    e.serializeState(s);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, '\n');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+  const size_t sequenceLength = decodedSequence.size();
+  const size_t historyFrames = historySize == 0 ? sequenceLength : std::min((size_t)historySize, sequenceLength);
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", sequenceLength);
+  printf("[] Keyframe Interval:                      %d\n", keyframeInterval);
+  printf("[] History:                                %lu frames\n", historyFrames);
+  printf("[] Rendering Again:                        every %lu frames\n", stride);
+  printf("[] ********** Running Test **********\n");
+  fflush(stdout);
+
+  // Every instance draws into a video buffer of its own
+  std::vector<std::vector<uint8_t>> videoBuffers;
+  for (auto emulator : {source, output, again})
+  {
+    videoBuffers.emplace_back(quickerNES::Emu::buffer_width * emulator->buffer_height());
+    emulator->set_pixels(videoBuffers.back().data(), quickerNES::Emu::buffer_width);
+  }
+
+  // Pixels are host palette entries, which depend on the palette history; frames are compared as NES colors
+  std::vector<uint16_t> frameColors(quickerNES::Emu::image_width * quickerNES::Emu::image_height);
+  auto hashFrame = [&](const quickerNES::Emu *emulator)
+  {
+    const auto &frame = emulator->frame();
+    for (size_t y = 0; y < quickerNES::Emu::image_height; y++)
+      for (size_t x = 0; x < quickerNES::Emu::image_width; x++) frameColors[y * quickerNES::Emu::image_width + x] = frame.palette[frame.pixels[y * frame.pitch + x]];
+    return jaffarCommon::hash::calculateMetroHash(frameColors.data(), frameColors.size() * sizeof(uint16_t));
+  };
+
+  auto loadInitialState = [&]()
+  {
+    jaffarCommon::deserializer::Contiguous d(initialState.data(), stateSize);
+    e.deserializeState(d);
+  };
+
+  // Direct rendering
+  std::vector<jaffarCommon::hash::hash_t> expectedHashes;
+  double directSeconds = 0.0;
+  loadInitialState();
+  for (const auto &input : decodedSequence)
+  {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    source->emulate_frame(input.port1, input.port2, 0, 0);
+    auto tf = std::chrono::high_resolution_clock::now();
+    directSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+    expectedHashes.push_back(hashFrame(source));
+  }
+
+  // Deferred rendering: each frame is checked while the source emulates the next one
+  loadInitialState();
+  quickerNES::Deferred_Renderer renderer;
+  const char *error = renderer.init(source, output, (int)historyFrames, keyframeInterval);
+  if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not start deferred renderer: %s\n", error);
+
+  double deferredSeconds = 0.0;
+  auto checkOutput = [&](const size_t frame)
+  {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    error = renderer.wait();
+    auto tf = std::chrono::high_resolution_clock::now();
+    deferredSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Deferred rendering of frame %lu failed: %s\n", frame, error);
+    if (hashFrame(output) != expectedHashes[frame]) JAFFAR_THROW_LOGIC("[ERROR] Deferred rendering differs from direct rendering (frame %lu)\n", frame);
+  };
+
+  for (size_t i = 0; i < sequenceLength; i++)
+  {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    source->emulate_skip_frame(decodedSequence[i].port1, decodedSequence[i].port2, 0, 0);
+    auto tf = std::chrono::high_resolution_clock::now();
+    deferredSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+
+    // The previous frame gets checked once it is out, before this one is handed over
+    if (i > 0) checkOutput(i - 1);
+
+    t0 = std::chrono::high_resolution_clock::now();
+    error = renderer.end_frame();
+    tf = std::chrono::high_resolution_clock::now();
+    deferredSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not hand over frame %lu: %s\n", i, error);
+  }
+  if (sequenceLength > 0) checkOutput(sequenceLength - 1);
+
+  // Rendering logged frames again. Only the last historyFrames frames are kept, and a frame can only
+  // be rendered from a keyframe (taken every keyframeInterval frames) still among them.
+  size_t renderedAgain = 0;
+  const size_t oldestFrame = sequenceLength - historyFrames;
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < sequenceLength; i += stride)
+  {
+    error = renderer.render_frame(i, again);
+    const bool renderable = i / keyframeInterval * keyframeInterval >= oldestFrame;
+    if (renderable == false)
+    {
+      if (error == nullptr) JAFFAR_THROW_LOGIC("[ERROR] Frame %lu rendered again, but it is no longer in the history\n", i);
+      continue;
+    }
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not render frame %lu again: %s\n", i, error);
+    if (hashFrame(again) != expectedHashes[i]) JAFFAR_THROW_LOGIC("[ERROR] Frame %lu rendered again differs from direct rendering\n", i);
+    renderedAgain++;
+  }
+  auto tf = std::chrono::high_resolution_clock::now();
+  const double againSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+
+  // Reporting
+  printf("[] Direct Rendering Performance:           %.3f frames / s\n", (double)sequenceLength / directSeconds);
+  printf("[] Deferred Rendering Performance:         %.3f frames / s (%.3fx, waiting on the worker included)\n", (double)sequenceLength / deferredSeconds, directSeconds / deferredSeconds);
+  printf("[] Frames Rendered Again:                  %lu (%.3f ms / frame)\n", renderedAgain, renderedAgain ? againSeconds * 1.0e3 / (double)renderedAgain : 0.0);
+
+  // If reached this point, everything ran ok
+  return 0;
+}
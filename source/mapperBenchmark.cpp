@@ -0,0 +1,251 @@
+#include "core/emu.hpp"
+#include "core/mappers/mapper004.hpp"
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <jaffarCommon/exceptions.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <random>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Measures the IRQ counters of the mappers that have one, and bank switching. Each benchmark runs
+// a generated cartridge. For IRQ counters, its program sets the counter up to fire an IRQ every
+// few scanlines and spins, while the IRQ handler acknowledges it and counts it in RAM; the frame
+// rate thus mostly reflects how fast the mapper advances its counter and predicts its next IRQ.
+// For bank switching, its program writes bank registers in a loop with rendering on, counting
+// the iterations in RAM, which gives the time each write takes.
+//
+// With --check, each cartridge runs a fixed number of frames once and must end in the state the
+// per-scanline and per-period counters gave, and MMC3's closed form clock_counter(count) is
+// checked against repeated single clocks from random states.
+
+// Register writes, as (address, value)
+typedef std::vector<std::pair<uint16_t, uint8_t>> writes_t;
+
+struct benchmark_t
+{
+  const char *name;
+  int mapper;
+  writes_t setup; // run once at reset, with rendering then enabled
+  writes_t ack;   // run by the IRQ handler
+  writes_t loop;  // run repeatedly by the main program
+  const char *expectedHash; // state hash after checkFrames frames
+};
+
+// Frames each cartridge runs with --check
+static const long checkFrames = 600;
+
+static const benchmark_t benchmarks[] = {
+  // IRQ every 16 scanlines
+  {"MMC3", 4, {{0xC000, 15}, {0xC001, 0}, {0xE001, 0}}, {{0xE000, 0}, {0xE001, 0}}, {}, "0xBEB9CCFE649ADBD64F944B869C941E8D"},
+
+  // Same, with A12 also clocked by the program through $2006 (to $1000) and $2007 (from $0FFF),
+  // between scanlines the counter hasn't been run up to yet
+  {"MMC3 A12", 4, {{0xC000, 15}, {0xC001, 0}, {0xE001, 0}}, {{0xE000, 0}, {0xE001, 0}}, {{0x2006, 0x10}, {0x2006, 0x00}, {0x2006, 0x0F}, {0x2006, 0xFF}, {0x2007, 0x00}, {0x2006, 0x00}, {0x2006, 0x00}}, "0xD0936E073E001A3A5B966EEFAEDC1401"},
+
+  // Timers of 16 scanlines, re-enabled by the acknowledgement
+  {"VRC4", 21, {{0xF000, 0x00}, {0xF002, 0x0F}, {0xF004, 0x03}}, {{0xF006, 0}}, {}, "0x6CA2F917D44115177DC72EB8807E6F0A"},
+  {"VRC6", 24, {{0xF000, 0xF0}, {0xF001, 0x03}}, {{0xF002, 0}}, {}, "0x5E3D103233AB378A106EB593D482DA57"},
+  {"VRC7", 85, {{0xE010, 0xF0}, {0xF000, 0x03}}, {{0xF010, 0}}, {}, "0x331E695CF8C6BB38E5D69CF8C967045F"},
+
+  // 2048-cycle counters
+  {"FME-7", 69, {{0x8000, 0x0E}, {0xA000, 0x00}, {0x8000, 0x0F}, {0xA000, 0x08}, {0x8000, 0x0D}, {0xA000, 0x81}}, {{0x8000, 0x0E}, {0xA000, 0x00}, {0x8000, 0x0F}, {0xA000, 0x08}, {0x8000, 0x0D}, {0xA000, 0x81}}, {}, "0xA3797ECECF349B3C0165EF5D94E8AB7"},
+  {"VRC3", 73, {{0x8000, 0x0}, {0x9000, 0x0}, {0xA000, 0x8}, {0xB000, 0xF}, {0xC000, 0x3}}, {{0xD000, 0}}, {}, "0x63704C23A9F69D0AD95B2F66F2952930"},
+
+  // Bank switches that leave the mapping as it is, and ones that change it
+  {"MMC3 CHR same", 4, {}, {}, {{0x8000, 0x02}, {0x8001, 0x04}}, "0x973DC4FA3D6975A4653244D799E2A422"},
+  {"MMC3 CHR swap", 4, {}, {}, {{0x8000, 0x02}, {0x8001, 0x04}, {0x8000, 0x02}, {0x8001, 0x05}}, "0x64A3C46D7CD270FAD04B28D5BA8F0B0A"},
+  {"MMC3 PRG same", 4, {}, {}, {{0x8000, 0x06}, {0x8001, 0x00}}, "0x46C792E0FEB4CB5417AFCD0D17A8E0DB"},
+  {"MMC3 PRG swap", 4, {}, {}, {{0x8000, 0x06}, {0x8001, 0x00}, {0x8000, 0x06}, {0x8001, 0x01}}, "0xAFD22B9FAFBBFF96FBC769E9FD9F0594"},
+  {"MMC3 NT same", 4, {}, {}, {{0xA000, 0x00}}, "0x47D0C6A98235E31E2B36189D132E75ED"},
+  {"MMC3 NT swap", 4, {}, {}, {{0xA000, 0x00}, {0xA000, 0x01}}, "0xE148248BCA2012CA999D846A2220F166"},
+  {"UxROM same", 2, {}, {}, {{0x8000, 0x00}}, "0xE973A2E66287FBA5AFA60EEF2F346EAE"},
+  {"UxROM swap", 2, {}, {}, {{0x8000, 0x00}, {0x8000, 0x01}}, "0x6406193822ED62275E9C80AAD54876B1"},
+};
+
+// 32K PRG, whose last 8K (fixed at 0xE000 on all of these mappers) holds the program, and 8K CHR
+static std::vector<uint8_t> make_rom(const benchmark_t &b)
+{
+  const size_t header_size = 16, prg_size = 0x8000, chr_size = 0x2000;
+  std::vector<uint8_t> rom(header_size + prg_size + chr_size, 0);
+  const uint8_t header[] = {'N', 'E', 'S', 0x1A, prg_size / 0x4000, chr_size / 0x2000, (uint8_t)((b.mapper & 0x0F) << 4), (uint8_t)(b.mapper & 0xF0)};
+  std::copy(header, header + sizeof header, rom.begin());
+
+  std::vector<uint8_t> code;
+  auto emit = [&](std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); };
+  auto emitWrites = [&](const writes_t &writes)
+  {
+    for (const auto &w : writes) emit({0xA9, w.second, 0x8D, (uint8_t)(w.first & 0xFF), (uint8_t)(w.first >> 8)}); // LDA #v; STA addr
+  };
+  const uint16_t base = 0xE000;
+
+  // Reset: SEI; CLD; LDX #$FF; TXS; disable APU frame IRQ; setup; enable background; CLI
+  const uint16_t reset = base;
+  emit({0x78, 0xD8, 0xA2, 0xFF, 0x9A});
+  emitWrites({{0x4017, 0x40}});
+  emitWrites(b.setup);
+  emitWrites({{0x2001, 0x08}});
+  emit({0x58});
+
+  // Loop: writes; INC $03; BNE +10; INC $04; BNE +6; INC $05; BNE +2; INC $06; JMP loop
+  const uint16_t loop = base + code.size();
+  emitWrites(b.loop);
+  if (!b.loop.empty()) emit({0xE6, 0x03, 0xD0, 0x0A, 0xE6, 0x04, 0xD0, 0x06, 0xE6, 0x05, 0xD0, 0x02, 0xE6, 0x06});
+  emit({0x4C, (uint8_t)(loop & 0xFF), (uint8_t)(loop >> 8)});
+
+  // IRQ: PHA; INC $00; BNE +6; INC $01; BNE +2; INC $02; acknowledge; PLA; RTI
+  const uint16_t irq = base + code.size();
+  emit({0x48, 0xE6, 0x00, 0xD0, 0x06, 0xE6, 0x01, 0xD0, 0x02, 0xE6, 0x02});
+  emitWrites(b.ack);
+  emit({0x68, 0x40});
+
+  // NMI: RTI (never enabled)
+  const uint16_t nmi = base + code.size();
+  emit({0x40});
+
+  uint8_t *bank = &rom[header_size + prg_size - 0x2000];
+  std::copy(code.begin(), code.end(), bank);
+  const uint16_t vectors[] = {nmi, reset, irq};
+  for (int i = 0; i < 3; i++)
+  {
+    bank[0x1FFA + i * 2] = vectors[i] & 0xFF;
+    bank[0x1FFB + i * 2] = vectors[i] >> 8;
+  }
+  return rom;
+}
+
+// Clocks MMC3's counter from random states, once in closed form and once a clock at a time
+static void check_mmc3_counter(long iterations)
+{
+  std::mt19937 rng(0);
+  quickerNES::Mapper004 single, closed;
+  auto &singleState = *(quickerNES::mmc3_state_t *)single.state;
+  auto &closedState = *(quickerNES::mmc3_state_t *)closed.state;
+  for (long i = 0; i < iterations; i++)
+  {
+    singleState.irq_ctr = rng();
+    singleState.irq_latch = rng() % 4 ? rng() : rng() % 4;
+    singleState.irq_enabled = rng() & 1;
+    singleState.irq_flag = rng() & 1;
+    single.counter_just_clocked = rng() % 3;
+    closedState = singleState;
+    closed.counter_just_clocked = single.counter_just_clocked;
+
+    const long count = rng() % 4 ? rng() % 16 : rng() % 1024;
+    for (long c = 0; c < count; c++) single.clock_counter();
+    closed.clock_counter(count);
+
+    if (memcmp(&singleState, &closedState, sizeof singleState) != 0 || single.counter_just_clocked != closed.counter_just_clocked)
+      JAFFAR_THROW_LOGIC("[ERROR] MMC3 clock_counter(%ld) differs from %ld single clocks at iteration %ld\n", count, count, i);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("mapperBenchmark", "1.0");
+
+  program.add_argument("--frames")
+    .help("Number of frames each mapper runs.")
+    .default_value(std::string("36000"));
+
+  program.add_argument("--repeat")
+    .help("Number of times each mapper runs its frames; the fastest run is reported.")
+    .default_value(std::string("5"));
+
+  program.add_argument("--check")
+    .help("Instead of timing, runs each mapper for a fixed number of frames once and checks its final state, and checks MMC3's closed form counter against single clocks.")
+    .default_value(false)
+    .implicit_value(true);
+
+  // Try to parse arguments
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str());
+  }
+
+  // Checking instead of timing
+  const bool checkEnabled = program.get<bool>("--check");
+
+  // Getting frame count
+  const long frameCount = checkEnabled ? checkFrames : std::stol(program.get<std::string>("--frames"));
+  if (frameCount < 1) JAFFAR_THROW_LOGIC("Frame count must be at least 1\n");
+
+  // Getting repetition count
+  const int repeatCount = checkEnabled ? 1 : std::stoi(program.get<std::string>("--repeat"));
+  if (repeatCount < 1) JAFFAR_THROW_LOGIC("Repetition count must be at least 1\n");
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Frames per Mapper:                      %ld\n", frameCount);
+  printf("[] Repetitions:                            %d\n", repeatCount);
+  printf("[] ********** Running Test **********\n");
+  fflush(stdout);
+
+  if (checkEnabled)
+  {
+    check_mmc3_counter(1000000);
+    printf("[] MMC3 closed form counter matches single clocks\n");
+  }
+
+  for (const auto &b : benchmarks)
+  {
+    const auto rom = make_rom(b);
+    quickerNES::Emu emulator;
+    const char *error = emulator.load_ines(rom.data(), rom.size());
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not load %s cartridge: %s\n", b.name, error);
+
+    // Every run restarts from power-up, so all of them end in the same state
+    const uint8_t *ram = emulator.get_low_mem();
+    auto irqCount = [&]() { return ram[0] | ram[1] << 8 | ram[2] << 16; };
+    auto loopCount = [&]() { return (uint32_t)(ram[3] | ram[4] << 8 | ram[5] << 16 | (uint32_t)ram[6] << 24); };
+    double seconds = 0.0;
+    int irqs = 0;
+    uint32_t loops = 0;
+    for (int r = 0; r < repeatCount; r++)
+    {
+      emulator.reset(true, true);
+      const int irqsBefore = irqCount();
+      const uint32_t loopsBefore = loopCount();
+      auto t0 = std::chrono::high_resolution_clock::now();
+      for (long i = 0; i < frameCount; i++) emulator.emulate_skip_frame(0, 0, 0, 0);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      const double runSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+      if (r == 0 || runSeconds < seconds) seconds = runSeconds;
+      irqs = (irqCount() - irqsBefore) & 0xFFFFFF;
+      loops = loopCount() - loopsBefore;
+    }
+
+    jaffarCommon::serializer::Contiguous size;
+    emulator.serializeState(size);
+    std::vector<uint8_t> state(size.getOutputSize());
+    jaffarCommon::serializer::Contiguous s(state.data(), state.size());
+    emulator.serializeState(s);
+    const auto stateHash = jaffarCommon::hash::calculateMetroHash(state.data(), state.size());
+
+    if (!b.ack.empty())
+      printf("[] %-14s (mapper %3d) %10.3f frames / s, %.2f IRQs / frame, State Hash 0x%lX%lX\n", b.name, b.mapper, (double)frameCount / seconds, (double)irqs / frameCount, stateHash.first, stateHash.second);
+    else
+    {
+      const double writes = (double)loops * b.loop.size();
+      printf("[] %-14s (mapper %3d) %10.3f frames / s, %.2f bank writes / frame, %.2f ns / write, State Hash 0x%lX%lX\n", b.name, b.mapper, (double)frameCount / seconds, writes / frameCount, seconds * 1.0e9 / writes, stateHash.first, stateHash.second);
+    }
+
+    if (checkEnabled)
+    {
+      char hash[64];
+      snprintf(hash, sizeof hash, "0x%lX%lX", stateHash.first, stateHash.second);
+      if (strcmp(hash, b.expectedHash) != 0) JAFFAR_THROW_LOGIC("[ERROR] %s ended in state %s instead of %s\n", b.name, hash, b.expectedHash);
+    }
+  }
+
+  // If reached this point, everything ran ok
+  return 0;
+}
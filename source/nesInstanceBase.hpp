@@ -37,6 +37,15 @@ class NESInstanceBase
     return status;
   }
 
+  // Uses the ROM already loaded by another instance of the same core, without parsing or copying it again.
+  // Returns false if the core cannot share ROMs, in which case it must be loaded with loadROM.
+  inline bool shareROM(NESInstanceBase &source)
+  {
+    auto status = shareROMImpl(source);
+    if (status == true) _stateSize = getFullStateSize();
+    return status;
+  }
+
   void enableStateBlock(const std::string &block)
   {
     // Calling implementation
@@ -76,10 +85,23 @@ class NESInstanceBase
   virtual void useFlatCodeMap() {};
   virtual void usePagedCodeMap() {};
 
+  // Selects whether the core renders with its vectorised (SIMD) code. Returns false if the core has none to switch.
+  virtual bool setSIMDRendering(const bool enabled) { return false; };
+
+  // Attaches a sound buffer producing samples at the given rate: mono, or stereo with effects. Returns false if the core cannot produce sound.
+  virtual bool enableAudio(const long sampleRate, const bool effects) { return false; };
+
+  // Reads the samples produced by the last rendered frame into the given buffer, returning how many were read
+  virtual size_t readAudioSamples(int16_t *samples, const size_t maxSamples) { return 0; };
+
+  // Counters of the work done in the last frame, as (name, value) pairs. Empty if the core does not collect them.
+  virtual void getFrameStats(std::vector<std::pair<const char *, uint64_t>> &stats) const { stats.clear(); };
+
   protected:
   virtual void enableStateBlockImpl(const std::string &block) = 0;
   virtual void disableStateBlockImpl(const std::string &block) = 0;
   virtual bool loadROMImpl(const uint8_t *romData, const size_t romSize) = 0;
+  virtual bool shareROMImpl(NESInstanceBase &source) { return false; }
 
   // Storage for the light state size
   size_t _stateSize;
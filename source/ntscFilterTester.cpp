@@ -0,0 +1,134 @@
+#include "nesInstance.hpp"
+#include "core/ntscFilter.hpp"
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/file.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/string.hpp>
+#include <string>
+#include <vector>
+
+// Measures the NTSC filter on the frames of a test sequence: each frame is filtered on a single
+// thread and on the requested number of threads, which must produce the same image.
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("ntscFilterTester", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("--threads")
+    .help("Number of threads filtering each frame.")
+    .default_value(std::string("4"));
+
+  // Try to parse arguments
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str());
+  }
+
+  // Getting test script file path
+  std::string scriptFilePath = program.get<std::string>("scriptFile");
+
+  // Getting thread count
+  const int threadCount = std::stoi(program.get<std::string>("--threads"));
+  if (threadCount < 1) JAFFAR_THROW_LOGIC("Thread count must be at least 1\n");
+
+  // Loading script file
+  std::string scriptJsonRaw;
+  if (jaffarCommon::file::loadStringFromFile(scriptJsonRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+
+  // Parsing script
+  const auto scriptJson = nlohmann::json::parse(scriptJsonRaw);
+
+  // Getting rom, initial state and sequence file paths
+  if (scriptJson.contains("Rom File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Rom File' entry\n");
+  if (scriptJson.contains("Initial State File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Initial State File' entry\n");
+  if (scriptJson.contains("Sequence File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Sequence File' entry\n");
+  std::string romFilePath = scriptJson["Rom File"].get<std::string>();
+  std::string initialStateFilePath = scriptJson["Initial State File"].get<std::string>();
+  std::string sequenceFilePath = scriptJson["Sequence File"].get<std::string>();
+
+  // Loading ROM
+  std::string romFileData;
+  if (jaffarCommon::file::loadStringFromFile(romFileData, romFilePath) == false) JAFFAR_THROW_LOGIC("Could not rom file: %s\n", romFilePath.c_str());
+
+  // Creating the emulating instance
+  NESInstance e(scriptJson);
+  e.loadROM((uint8_t *)romFileData.data(), romFileData.size());
+  auto emulator = (quickerNES::Emu *)e.getInternalEmulatorPointer();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, '\n');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+  const size_t sequenceLength = decodedSequence.size();
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", sequenceLength);
+  printf("[] Output Size:                            %u x %u\n", quickerNES::Ntsc_Filter::out_width, quickerNES::Ntsc_Filter::out_height);
+  printf("[] Threads:                                %d\n", threadCount);
+  printf("[] ********** Running Test **********\n");
+  fflush(stdout);
+
+  // Rendering into an indexed video buffer
+  std::vector<uint8_t> videoBuffer(quickerNES::Emu::buffer_width * emulator->buffer_height());
+  emulator->set_pixels(videoBuffer.data(), quickerNES::Emu::buffer_width);
+
+  quickerNES::Ntsc_Filter singleFilter, multiFilter;
+  const char *error = singleFilter.init(quickerNES::Emu::pixels_rgba32, 1);
+  if (error == nullptr) error = multiFilter.init(quickerNES::Emu::pixels_rgba32, threadCount);
+  if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not initialize NTSC filter: %s\n", error);
+
+  const size_t outRowBytes = quickerNES::Ntsc_Filter::out_width * 4;
+  std::vector<uint8_t> singleOutput(outRowBytes * quickerNES::Ntsc_Filter::out_height);
+  std::vector<uint8_t> multiOutput(singleOutput.size());
+
+  double singleSeconds = 0.0;
+  double multiSeconds = 0.0;
+  jaffarCommon::hash::hash_t lastHash;
+  for (size_t i = 0; i < sequenceLength; i++)
+  {
+    emulator->emulate_frame(decodedSequence[i].port1, decodedSequence[i].port2, 0, 0);
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    error = singleFilter.blit(emulator->frame(), singleOutput.data(), outRowBytes);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (error == nullptr) error = multiFilter.blit(emulator->frame(), multiOutput.data(), outRowBytes);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not filter frame %lu: %s\n", i, error);
+    singleSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+    multiSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() * 1.0e-9;
+
+    if (singleOutput != multiOutput) JAFFAR_THROW_LOGIC("[ERROR] Filtering on %d threads differs from a single thread (frame %lu)\n", threadCount, i);
+    lastHash = jaffarCommon::hash::calculateMetroHash(singleOutput.data(), singleOutput.size());
+  }
+
+  // Reporting
+  printf("[] Single Thread Performance:              %.3f frames / s\n", (double)sequenceLength / singleSeconds);
+  printf("[] Multi Thread Performance:               %.3f frames / s (%.3fx)\n", (double)sequenceLength / multiSeconds, singleSeconds / multiSeconds);
+  printf("[] Last Filtered Frame Hash:               0x%lX%lX\n", lastHash.first, lastHash.second);
+
+  // If reached this point, everything ran ok
+  return 0;
+}
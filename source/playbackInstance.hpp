@@ -116,16 +116,14 @@ class PlaybackInstance
 
   void enableRendering(SDL_Window *window)
   {
-    // Allocating video buffer
-    _video_buffer = (uint8_t *)malloc(image_width * image_height);
+    // Allocating video buffer, the size of the GUI blit
+    _video_buffer = (int32_t *)calloc(BLIT_SIZE, sizeof(int32_t));
 
-    // Setting video buffer
-    ((emulator_t *)_emu->getInternalEmulatorPointer())->set_pixels(_video_buffer, image_width + 8);
+    // The emulator writes final colors directly, in the byte order of the GUI texture
+    ((emulator_t *)_emu->getInternalEmulatorPointer())->set_pixels(_video_buffer, image_width * sizeof(int32_t), emulator_t::pixels_bgra32);
 
     // Loading Emulator instance HQN
     _hqnState.setEmulatorPointer(_emu->getInternalEmulatorPointer());
-    static uint8_t video_buffer[image_width * image_height];
-    _hqnState.m_emu->set_pixels(video_buffer, image_width + 8);
 
     // Enabling emulation rendering
     _emu->enableRendering();
@@ -182,9 +180,7 @@ class PlaybackInstance
     }
 
     // Updating image
-    int32_t curBlit[BLIT_SIZE];
-    saveBlit(_emu->getInternalEmulatorPointer(), curBlit, hqn::HQNState::NES_VIDEO_PALETTE, 0, 0, 0, 0);
-    _hqnGUI->update_blit(curBlit, _overlayBaseSurface, overlayButtonASurface, overlayButtonBSurface, overlayButtonSelectSurface, overlayButtonStartSurface, overlayButtonLeftSurface, overlayButtonRightSurface, overlayButtonUpSurface, overlayButtonDownSurface);
+    _hqnGUI->update_blit(_video_buffer, _overlayBaseSurface, overlayButtonASurface, overlayButtonBSurface, overlayButtonSelectSurface, overlayButtonStartSurface, overlayButtonLeftSurface, overlayButtonRightSurface, overlayButtonUpSurface, overlayButtonDownSurface);
   }
 
   size_t getSequenceLength() const
@@ -258,7 +254,7 @@ class PlaybackInstance
   bool _useOverlay = false;
 
   // Video buffer
-  uint8_t *_video_buffer;
+  int32_t *_video_buffer;
 
   // Overlay info
   std::string _overlayPath;
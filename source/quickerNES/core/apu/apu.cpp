@@ -93,6 +93,8 @@ void Apu::reset(bool pal_mode, int initial_dmc_dac)
   dmc.reset();
 
   last_time = 0;
+  for (int i = 0; i < 4; i++)
+    osc_times[i] = 0;
   last_dmc_time = 0;
   osc_enables = 0;
   irq_flag = false;
@@ -133,21 +135,13 @@ void Apu::irq_changed()
 
 // frames
 
-void Apu::run_until(nes_time_t end_time)
-{
-  if (end_time > next_dmc_read_time())
-  {
-    nes_time_t start = last_dmc_time;
-    last_dmc_time = end_time;
-    dmc.run(start, end_time);
-  }
-}
-
 void Apu::run_until_(nes_time_t end_time)
 {
   if (end_time == last_time)
     return;
 
+  NES_STAT(if (stats) stats->apu_runs++);
+
   if (last_dmc_time < end_time)
   {
     nes_time_t start = last_dmc_time;
@@ -163,11 +157,15 @@ void Apu::run_until_(nes_time_t end_time)
       time = end_time;
     frame_delay -= time - last_time;
 
-    // run oscs to present
-    square1.run(last_time, time);
-    square2.run(last_time, time);
-    triangle.run(last_time, time);
-    noise.run(last_time, time);
+    // run oscs to present; muted ones are caught up where their phase is affected
+    if (square1.output)
+      run_osc(0, time);
+    if (square2.output)
+      run_osc(1, time);
+    if (triangle.output || !triangle.can_defer())
+      run_osc(2, time);
+    if (noise.output || !noise.can_defer())
+      run_osc(3, time);
     last_time = time;
 
     if (time == end_time)
@@ -175,6 +173,7 @@ void Apu::run_until_(nes_time_t end_time)
 
     // take frame-specific actions
     frame_delay = frame_period;
+    catch_up_osc(2, time); // linear counter
     switch (frame++)
     {
     case 0:
@@ -186,6 +185,8 @@ void Apu::run_until_(nes_time_t end_time)
       // fall through
     case 2:
       // clock length and sweep on frames 0 and 2
+      catch_up_osc(0, time);
+      catch_up_osc(1, time);
       square1.clock_length(0x20);
       square2.clock_length(0x20);
       noise.clock_length(0x20);
@@ -217,6 +218,32 @@ void Apu::run_until_(nes_time_t end_time)
   }
 }
 
+void Apu::run_osc(int index, nes_time_t time)
+{
+  // Run a tone oscillator from where it was left. Without output this only advances its phase,
+  // and runs can be combined as long as its period and, for the triangle, its counters stay the
+  // same, so muted oscillators are only run before these change and at the end of the frame.
+  // The triangle while playing and the noise after its period was shortened are exceptions,
+  // which still run along with the frame counter (see can_defer()).
+  nes_time_t start = osc_times[index];
+  osc_times[index] = time;
+  switch (index)
+  {
+  case 0:
+    square1.run(start, time);
+    break;
+  case 1:
+    square2.run(start, time);
+    break;
+  case 2:
+    triangle.run(start, time);
+    break;
+  case 3:
+    noise.run(start, time);
+    break;
+  }
+}
+
 template <class T>
 inline void zero_apu_osc(T *osc, nes_time_t time)
 {
@@ -231,6 +258,8 @@ void Apu::end_frame(nes_time_t end_time)
 {
   if (end_time > last_time)
     run_until_(end_time);
+  for (int i = 0; i < 4; i++)
+    catch_up_osc(i, last_time);
 
   if (dmc.nonlinear)
   {
@@ -243,6 +272,8 @@ void Apu::end_frame(nes_time_t end_time)
 
   // make times relative to new frame
   last_time -= end_time;
+  for (int i = 0; i < 4; i++)
+    osc_times[i] -= end_time;
   last_dmc_time -= end_time;
 
   if (next_irq != no_irq)
@@ -279,6 +310,8 @@ void Apu::write_register(nes_time_t time, nes_addr_t addr, int data)
     // Write to channel
     int osc_index = (addr - start_addr) >> 2;
     Osc *osc = oscs[osc_index];
+    if (osc_index < 4)
+      catch_up_osc(osc_index, time);
 
     int reg = addr & 3;
     osc->regs[reg] = data;
@@ -303,6 +336,7 @@ void Apu::write_register(nes_time_t time, nes_addr_t addr, int data)
   else if (addr == 0x4015)
   {
     // Channel enables
+    catch_up_osc(2, time); // triangle stops with its length counter
     for (int i = osc_count; i--;)
       if (!((data >> i) & 1))
         oscs[i]->length_counter = 0;
@@ -3,6 +3,7 @@
 // NES 2A03 APU sound chip emulator
 // Snd_Emu 0.1.7
 
+#include "../stats.hpp"
 #include "oscs.hpp"
 #include <limits.h>
 #include <stdint.h>
@@ -132,7 +133,9 @@ class Apu
   // Set sound output of specific oscillator to buffer. If buffer is NULL,
   // the specified oscillator is muted and emulation accuracy is reduced.
   // The oscillators are indexed as follows: 0) Square 1, 1) Square 2,
-  // 2) Triangle, 3) Noise, 4) DMC.
+  // 2) Triangle, 3) Noise, 4) DMC. A muted tone oscillator only keeps track
+  // of its phase, which is caught up lazily (see run_osc()), so outputs can
+  // be changed at any time.
   static const uint16_t osc_count = 5;
   void osc_output(int index, Blip_Buffer *buffer);
 
@@ -160,6 +163,11 @@ class Apu
   // accounted for (i.e. inserting CPU wait states).
   void run_until(nes_time_t);
 
+#ifdef _QUICKERNES_ENABLE_STATS
+  // Frame statistics the APU counts its catch-ups into, if set
+  frame_stats_t *stats = nullptr;
+#endif
+
   // End of public interface.
   private:
   friend class Nonlinearizer;
@@ -181,6 +189,7 @@ class Apu
   Dmc dmc;
 
   nes_time_t last_time; // has been run until this time in current frame
+  nes_time_t osc_times[4]; // time each tone oscillator has been run until
   nes_time_t last_dmc_time;
   nes_time_t earliest_irq_;
   nes_time_t next_irq;
@@ -197,6 +206,12 @@ class Apu
   void irq_changed();
   void state_restored();
   void run_until_(nes_time_t);
+  void run_osc(int index, nes_time_t);
+  void catch_up_osc(int index, nes_time_t time)
+  {
+    if (osc_times[index] != time)
+      run_osc(index, time);
+  }
 
   // TODO: remove
   friend class Core;
@@ -239,6 +254,18 @@ inline nes_time_t Dmc::next_read_time() const
 
 inline nes_time_t Apu::next_dmc_read_time() const { return dmc.next_read_time(); }
 
+inline void Apu::run_until(nes_time_t end_time)
+{
+  NES_STAT(if (stats) stats->apu_runs++);
+
+  if (end_time > next_dmc_read_time())
+  {
+    nes_time_t start = last_dmc_time;
+    last_dmc_time = end_time;
+    dmc.run(start, end_time);
+  }
+}
+
 template <int mode>
 struct apu_reflection
 {
@@ -314,6 +341,8 @@ inline void Apu::save_state(apu_state_t *state) const
 
   typedef apu_reflection<1> refl;
   Apu &apu = *(Apu *)this; // const_cast
+  for (int i = 0; i < 4; i++)
+    apu.catch_up_osc(i, last_time);
   refl::reflect_square(state->square1, apu.square1);
   refl::reflect_square(state->square2, apu.square2);
   refl::reflect_triangle(state->triangle, apu.triangle);
@@ -7,6 +7,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef BLIP_X86_SIMD
+  #include <immintrin.h>
+#endif
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -23,12 +27,49 @@ namespace quickerNES
 
 int const buffer_extra = blip_widest_impulse_ + 2;
 
+#ifdef BLIP_X86_SIMD
+
+static_assert(sizeof(Blip_Buffer::buf_t_) == 8, "AVX2 kernel adds 64-bit samples");
+
+// Adds kernel [i] * delta to buf [i] for i < width
+__attribute__((target("avx2"))) static void add_kernel_avx2(long *buf, short const *kernel, int width, int delta)
+{
+  // widths are multiples of 4
+  __m256i const d = _mm256_set1_epi64x(delta);
+  for (int i = 0; i < width; i += 4)
+  {
+    __m256i k = _mm256_cvtepi16_epi64(_mm_loadl_epi64((__m128i const *)(kernel + i)));
+    __m256i b = _mm256_loadu_si256((__m256i const *)(buf + i));
+    _mm256_storeu_si256((__m256i *)(buf + i), _mm256_add_epi64(b, _mm256_mul_epi32(k, d)));
+  }
+}
+
+#endif
+
+bool Blip_Buffer::simd_available()
+{
+#ifdef BLIP_X86_SIMD
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+void Blip_Buffer::set_simd(bool enabled)
+{
+  add_kernel_ = 0;
+#ifdef BLIP_X86_SIMD
+  if (enabled && simd_available()) add_kernel_ = add_kernel_avx2;
+#endif
+}
+
 Blip_Buffer::Blip_Buffer()
 {
   factor_ = LONG_MAX;
   offset_ = 0;
   buffer_ = 0;
   buffer_size_ = 0;
+  add_kernel_ = 0;
   sample_rate_ = 0;
   reader_accum = 0;
   bass_shift = 0;
@@ -151,8 +192,9 @@ void Blip_Buffer::remove_samples(long count)
 
 // Blip_Synth_
 
-Blip_Synth_::Blip_Synth_(short *p, int w) : impulses(p),
-                                            width(w)
+Blip_Synth_::Blip_Synth_(short *p, short *k, int w) : impulses(p),
+                                                      kernels(k),
+                                                      width(w)
 {
   volume_unit_ = 0.0;
   kernel_unit = 0;
@@ -236,6 +278,23 @@ void Blip_Synth_::adjust_impulse()
   // for ( int i = blip_res; i--; printf( "\n" ) )
   //   for ( int j = 0; j < width / 2; j++ )
   //       printf( "%5ld,", impulses [j * blip_res + i + 1] );
+
+  build_kernels();
+}
+
+void Blip_Synth_::build_kernels()
+{
+  // each phase's impulse in buffer order: its first half runs forward from blip_res - phase,
+  // the second half backward to phase
+  for (int phase = 0; phase < blip_res; phase++)
+  {
+    short *kernel = kernels + phase * width;
+    for (int i = 0; i < width / 2; i++)
+    {
+      kernel[i] = impulses[blip_res - phase + blip_res * i];
+      kernel[width - 1 - i] = impulses[phase + blip_res * i];
+    }
+  }
 }
 
 void Blip_Synth_::treble_eq(blip_eq_t const &eq)
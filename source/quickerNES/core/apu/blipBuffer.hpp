@@ -52,6 +52,13 @@ class Blip_Buffer
   // Set frequency high-pass filter frequency, where higher values reduce bass more
   void bass_freq(int frequency);
 
+  // Synthesize with vectorized loops when the host CPU supports them (off by default). The
+  // samples are the same either way.
+  void set_simd(bool enabled);
+
+  // True if the host CPU supports the vectorized loops
+  static bool simd_available();
+
   // Number of samples delay from synthesis to samples read out
   int output_latency() const;
 
@@ -105,6 +112,7 @@ class Blip_Buffer
   blip_resampled_time_t offset_;
   buf_t_ *buffer_;
   long buffer_size_;
+  void (*add_kernel_)(buf_t_ *buf, short const *kernel, int width, int delta); // null for scalar
 
   private:
   long reader_accum;
@@ -150,21 +158,28 @@ int const blip_widest_impulse_ = 16;
 int const blip_res = 1 << BLIP_PHASE_BITS;
 class blip_eq_t;
 
+// The vectorized loops add to 64-bit buffer samples
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__LP64__)
+  #define BLIP_X86_SIMD 1
+#endif
+
 class Blip_Synth_
 {
   double volume_unit_;
   short *const impulses;
+  short *const kernels;
   int const width;
   long kernel_unit;
   int impulses_size() const { return blip_res / 2 * width + 1; }
   void adjust_impulse();
+  void build_kernels();
 
   public:
   Blip_Buffer *buf;
   int last_amp;
   int delta_factor;
 
-  Blip_Synth_(short *impulses, int width);
+  Blip_Synth_(short *impulses, short *kernels, int width);
   void treble_eq(blip_eq_t const &);
   void volume_unit(double);
 };
@@ -221,11 +236,12 @@ class Blip_Synth
   }
 
   public:
-  Blip_Synth() : impl(impulses, quality) {}
+  Blip_Synth() : impl(impulses, kernels, quality) {}
 
   private:
   typedef short imp_t;
   imp_t impulses[blip_res * (quality / 2) + 1];
+  imp_t kernels[blip_res * quality]; // impulses rearranged per phase, in buffer order
   Blip_Synth_ impl;
 };
 
@@ -284,24 +300,6 @@ const long blip_unscaled = 65535;
 const int blip_low_quality = blip_med_quality;
 const int blip_best_quality = blip_high_quality;
 
-#define BLIP_FWD(i)                                               \
-  {                                                               \
-    long t0 = i0 * delta + buf[fwd + i];                          \
-    long t1 = imp[blip_res * (i + 1)] * delta + buf[fwd + 1 + i]; \
-    i0 = imp[blip_res * (i + 2)];                                 \
-    buf[fwd + i] = t0;                                            \
-    buf[fwd + 1 + i] = t1;                                        \
-  }
-
-#define BLIP_REV(r)                                         \
-  {                                                         \
-    long t0 = i0 * delta + buf[rev - r];                    \
-    long t1 = imp[blip_res * r] * delta + buf[rev + 1 - r]; \
-    i0 = imp[blip_res * (r - 1)];                           \
-    buf[rev - r] = t0;                                      \
-    buf[rev + 1 - r] = t1;                                  \
-  }
-
 template <int quality, int range>
 inline void Blip_Synth<quality, range>::offset_resampled(blip_resampled_time_t time,
                                                          int delta,
@@ -311,38 +309,19 @@ inline void Blip_Synth<quality, range>::offset_resampled(blip_resampled_time_t t
   // need for a longer buffer as set by set_sample_rate().
   delta *= impl.delta_factor;
   int phase = (int)(time >> (BLIP_BUFFER_ACCURACY - BLIP_PHASE_BITS) & (blip_res - 1));
-  imp_t const *imp = impulses + blip_res - phase;
-  long *buf = blip_buf->buffer_ + (time >> BLIP_BUFFER_ACCURACY);
-  long i0 = *imp;
-
-  int const fwd = (blip_widest_impulse_ - quality) / 2;
-  int const rev = fwd + quality - 2;
-
-  BLIP_FWD(0)
-  if (quality > 8) BLIP_FWD(2)
-  if (quality > 12) BLIP_FWD(4)
-    {
-      int const mid = quality / 2 - 1;
-      long t0 = i0 * delta + buf[fwd + mid - 1];
-      long t1 = imp[blip_res * mid] * delta + buf[fwd + mid];
-      imp = impulses + phase;
-      i0 = imp[blip_res * mid];
-      buf[fwd + mid - 1] = t0;
-      buf[fwd + mid] = t1;
-    }
-  if (quality > 12) BLIP_REV(6)
-  if (quality > 8) BLIP_REV(4)
-  BLIP_REV(2)
-
-  long t0 = i0 * delta + buf[rev];
-  long t1 = *imp * delta + buf[rev + 1];
-  buf[rev] = t0;
-  buf[rev + 1] = t1;
+  imp_t const *kernel = kernels + phase * quality;
+  long *buf = blip_buf->buffer_ + (time >> BLIP_BUFFER_ACCURACY) + (blip_widest_impulse_ - quality) / 2;
+#ifdef BLIP_X86_SIMD
+  if (blip_buf->add_kernel_)
+  {
+    blip_buf->add_kernel_(buf, kernel, quality, delta);
+    return;
+  }
+#endif
+  for (int i = 0; i < quality; i++)
+    buf[i] += kernel[i] * (long)delta;
 }
 
-#undef BLIP_FWD
-#undef BLIP_REV
-
 template <int quality, int range>
 void Blip_Synth<quality, range>::offset(blip_time_t t, int delta, Blip_Buffer *buf) const
 {
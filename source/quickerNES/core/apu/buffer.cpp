@@ -55,6 +55,12 @@ void Buffer::bass_freq(int freq)
   tnd.bass_freq(freq);
 }
 
+void Buffer::set_simd(bool enabled)
+{
+  buf.set_simd(enabled);
+  tnd.set_simd(enabled);
+}
+
 void Buffer::clear()
 {
   nonlin.clear();
@@ -62,6 +62,7 @@ class Buffer : public Multi_Buffer
 
   void clock_rate(long);
   void bass_freq(int);
+  void set_simd(bool);
   void clear();
   channel_t channel(int);
   void end_frame(blip_time_t, bool unused = true);
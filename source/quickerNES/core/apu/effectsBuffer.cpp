@@ -120,6 +120,12 @@ void Effects_Buffer::bass_freq(int freq)
     bufs[i].bass_freq(freq);
 }
 
+void Effects_Buffer::set_simd(bool enabled)
+{
+  for (int i = 0; i < buf_count; i++)
+    bufs[i].set_simd(enabled);
+}
+
 void Effects_Buffer::clear()
 {
   stereo_remain = 0;
@@ -48,6 +48,7 @@ class Effects_Buffer : public Multi_Buffer
   const char *set_sample_rate(long samples_per_sec, int msec = blip_default_length);
   void clock_rate(long);
   void bass_freq(int);
+  void set_simd(bool);
   void clear();
   channel_t channel(int);
   void end_frame(blip_time_t, bool was_stereo = true);
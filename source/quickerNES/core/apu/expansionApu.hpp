@@ -0,0 +1,35 @@
+#pragma once
+
+// Common interface of the sound chips on cartridges
+
+#include "blipBuffer.hpp"
+#include "oscs.hpp"
+
+namespace quickerNES
+{
+
+// Sound chip on a cartridge. The core gives its channels the sound buffers after the APU's, sets
+// its treble, and ends its time frames; the mapper passes it the CPU's accesses to its registers.
+class Expansion_Apu
+{
+  public:
+  virtual ~Expansion_Apu() {}
+
+  // Number of output channels
+  virtual int channel_count() const = 0;
+
+  // Set buffer for channel to output to, or NULL to silence it
+  virtual void osc_output(int index, Blip_Buffer *) = 0;
+
+  // Set treble equalization
+  virtual void treble_eq(blip_eq_t const &) = 0;
+
+  // Access register at CPU address, with the bits the mapper doesn't decode already removed
+  virtual void write_register(nes_time_t, nes_addr_t, int data) = 0;
+  virtual int read_register(nes_time_t, nes_addr_t) { return 0; }
+
+  // Run channels until time, then start a new time frame at time 0
+  virtual void end_frame(nes_time_t) = 0;
+};
+
+} // namespace quickerNES
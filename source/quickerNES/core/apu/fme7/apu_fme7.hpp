@@ -4,6 +4,7 @@
 // Emu 0.7.0
 
 #include "../blipBuffer.hpp"
+#include "../expansionApu.hpp"
 #include <stdint.h>
 
 namespace quickerNES
@@ -22,7 +23,7 @@ struct fme7_apu_state_t
 };
 static_assert(sizeof(fme7_apu_state_t) == 24);
 
-class Fme7_Apu : private fme7_apu_state_t
+class Fme7_Apu : public Expansion_Apu, private fme7_apu_state_t
 {
   public:
   Fme7_Apu();
@@ -36,6 +37,7 @@ class Fme7_Apu : private fme7_apu_state_t
   {
     osc_count = 3
   };
+  int channel_count() const { return osc_count; }
   void osc_output(int index, Blip_Buffer *);
   void end_frame(blip_time_t);
   void save_state(fme7_apu_state_t *) const;
@@ -61,6 +63,15 @@ class Fme7_Apu : private fme7_apu_state_t
   // (addr & addr_mask) == data_addr
   void write_data(blip_time_t, int data);
 
+  // Write at either register's address
+  void write_register(nes_time_t time, nes_addr_t addr, int data)
+  {
+    if ((addr & addr_mask) == latch_addr)
+      write_latch(data);
+    else
+      write_data(time, data);
+  }
+
   // End of public interface
   private:
   // noncopyable
@@ -139,6 +139,12 @@ void Stereo_Buffer::bass_freq(int bass)
     bufs[i].bass_freq(bass);
 }
 
+void Stereo_Buffer::set_simd(bool enabled)
+{
+  for (int i = 0; i < buf_count; i++)
+    bufs[i].set_simd(enabled);
+}
+
 void Stereo_Buffer::clear()
 {
   stereo_added = false;
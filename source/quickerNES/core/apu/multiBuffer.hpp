@@ -33,6 +33,7 @@ class Multi_Buffer
   virtual const char *set_sample_rate(long rate, int msec = blip_default_length) = 0;
   virtual void clock_rate(long) = 0;
   virtual void bass_freq(int) = 0;
+  virtual void set_simd(bool) = 0;
   virtual void clear() = 0;
   long sample_rate() const;
 
@@ -94,6 +95,7 @@ class Mono_Buffer : public Multi_Buffer
   const char *set_sample_rate(long rate, int msec = blip_default_length);
   void clock_rate(long);
   void bass_freq(int);
+  void set_simd(bool);
   void clear();
   channel_t channel(int);
   void end_frame(blip_time_t, bool unused = true);
@@ -120,6 +122,7 @@ class Stereo_Buffer : public Multi_Buffer
   const char *set_sample_rate(long, int msec = blip_default_length);
   void clock_rate(long);
   void bass_freq(int);
+  void set_simd(bool);
   void clear();
   channel_t channel(int index);
   void end_frame(blip_time_t, bool added_stereo = true);
@@ -155,6 +158,7 @@ class Silent_Buffer : public Multi_Buffer
   const char *set_sample_rate(long rate, int msec = blip_default_length);
   void clock_rate(long) {}
   void bass_freq(int) {}
+  void set_simd(bool) {}
   void clear() {}
   channel_t channel(int) { return chan; }
   void end_frame(blip_time_t, bool unused = true) {}
@@ -195,6 +199,8 @@ inline void Mono_Buffer::clear() { buf.clear(); }
 
 inline void Mono_Buffer::bass_freq(int freq) { buf.bass_freq(freq); }
 
+inline void Mono_Buffer::set_simd(bool enabled) { buf.set_simd(enabled); }
+
 inline long Mono_Buffer::read_samples(blip_sample_t *p, long s) { return buf.read_samples(p, s); }
 
 inline long Mono_Buffer::samples_avail() const { return buf.samples_avail(); }
@@ -4,6 +4,7 @@
 // Snd_Emu 0.1.7
 
 #include "../apu.hpp"
+#include "../expansionApu.hpp"
 #include <stdint.h>
 
 namespace quickerNES
@@ -19,7 +20,7 @@ struct namco_state_t
 };
 static_assert(sizeof(namco_state_t) == 172);
 
-class Namco_Apu
+class Namco_Apu : public Expansion_Apu
 {
   public:
   Namco_Apu();
@@ -33,6 +34,7 @@ class Namco_Apu
   {
     osc_count = 8
   };
+  int channel_count() const { return osc_count; }
   void osc_output(int index, Blip_Buffer *);
   void reset();
   void end_frame(nes_time_t);
@@ -52,6 +54,10 @@ class Namco_Apu
   };
   void write_addr(int);
 
+  // Access at either register's address
+  void write_register(nes_time_t, nes_addr_t, int data);
+  int read_register(nes_time_t, nes_addr_t) { return read_data(); }
+
   // to do: implement save/restore
   void save_state(namco_state_t *out) const;
   void load_state(namco_state_t const &);
@@ -112,4 +118,12 @@ inline void Namco_Apu::write_data(nes_time_t time, int data)
   access() = data;
 }
 
+inline void Namco_Apu::write_register(nes_time_t time, nes_addr_t addr, int data)
+{
+  if (addr == data_reg_addr)
+    write_data(time, data);
+  else
+    write_addr(data);
+}
+
 } // namespace quickerNES
\ No newline at end of file
@@ -602,15 +602,26 @@ void Dmc::run(nes_time_t time, nes_time_t end_time)
 static const short noise_period_table[16] = {
   0x004, 0x008, 0x010, 0x020, 0x040, 0x060, 0x080, 0x0A0, 0x0CA, 0x0FE, 0x17C, 0x1FC, 0x2FA, 0x3F8, 0x7F2, 0xFE4};
 
-void Noise::run(nes_time_t time, nes_time_t end_time)
+static inline int noise_period(int reg)
 {
-  int period = noise_period_table[regs[2] & 15];
+  int period = noise_period_table[reg & 15];
 #if NES_APU_NOISE_LOW_CPU
   if (period < 8)
   {
     period = 8;
   }
 #endif
+  return period;
+}
+
+bool Noise::can_defer() const
+{
+  return delay < noise_period(regs[2]);
+}
+
+void Noise::run(nes_time_t time, nes_time_t end_time)
+{
+  int period = noise_period(regs[2]);
 
   if (!output)
   {
@@ -103,6 +103,10 @@ struct Triangle : Osc
   int calc_amp() const;
   void run(nes_time_t, nes_time_t);
   void clock_linear_counter();
+
+  // Without output, each run that steps the phase moves it two steps less than it counted, so
+  // runs can only be combined while the triangle is halted.
+  bool can_defer() const { return !length_counter || !linear_counter || period() + 1 < 3; }
   void reset()
   {
     linear_counter = 0;
@@ -119,6 +123,11 @@ struct Noise : Envelope
   Blip_Synth<blip_med_quality, 1> synth;
 
   void run(nes_time_t, nes_time_t);
+
+  // Without output, a run that ends before the next step takes whole periods off a delay longer
+  // than two periods (after the period was shortened), so such runs can't be combined.
+  bool can_defer() const;
+
   void reset()
   {
     noise = 1 << 14;
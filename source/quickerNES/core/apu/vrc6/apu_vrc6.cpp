@@ -30,7 +30,6 @@ Vrc6_Apu::~Vrc6_Apu()
 
 void Vrc6_Apu::reset()
 {
-  last_time = 0;
   for (int i = 0; i < osc_count; i++)
   {
     Vrc6_Osc &osc = oscs[i];
@@ -40,6 +39,7 @@ void Vrc6_Apu::reset()
     osc.last_amp = 0;
     osc.phase = 1;
     osc.amp = 0;
+    osc.last_time = 0;
   }
 }
 
@@ -49,26 +49,43 @@ void Vrc6_Apu::output(Blip_Buffer *buf)
     osc_output(i, buf);
 }
 
+void Vrc6_Apu::run_osc(int index, nes_time_t time)
+{
+  if (index < 2)
+    run_square(oscs[index], time);
+  else
+    run_saw(time);
+  oscs[index].last_time = time;
+}
+
 void Vrc6_Apu::run_until(nes_time_t time)
 {
-  run_square(oscs[0], time);
-  run_square(oscs[1], time);
-  run_saw(time);
-  last_time = time;
+  for (int i = 0; i < osc_count; i++)
+    run_osc(i, time);
 }
 
 void Vrc6_Apu::write_osc(nes_time_t time, int osc_index, int reg, int data)
 {
-  run_until(time);
+  run_osc(osc_index, time);
+
+  // An enabled saw without a rate steps until its accumulator wraps and then stops, dropping its
+  // phase and delay, so until it has stopped it must run when the others do
+  Vrc6_Osc const &saw = oscs[2];
+  if (osc_index != 2 && (saw.regs[2] & 0x80) && !(saw.regs[0] & 0x3F) && (saw.amp | saw.delay))
+    run_osc(2, time);
+
   oscs[osc_index].regs[reg] = data;
 }
 
 void Vrc6_Apu::end_frame(nes_time_t time)
 {
-  if (time > last_time)
-    run_until(time);
+  for (int i = 0; i < osc_count; i++)
+  {
+    if (time > oscs[i].last_time)
+      run_osc(i, time);
 
-  last_time -= time;
+    oscs[i].last_time -= time;
+  }
 }
 
 void Vrc6_Apu::save_state(vrc6_apu_state_t *out) const
@@ -102,7 +119,7 @@ void Vrc6_Apu::load_state(vrc6_apu_state_t const &in)
     oscs[2].phase = 1;
 
   // Run sound channels for 0 cycles for clean audio after loading state
-  this->run_until(this->last_time);
+  this->run_until(0);
 }
 
 void Vrc6_Apu::run_square(Vrc6_Osc &osc, nes_time_t end_time)
@@ -118,7 +135,7 @@ void Vrc6_Apu::run_square(Vrc6_Osc &osc, nes_time_t end_time)
   int gate = osc.regs[0] & 0x80;
   int duty = ((osc.regs[0] >> 4) & 7) + 1;
   int delta = ((gate || osc.phase < duty) ? volume : 0) - osc.last_amp;
-  nes_time_t time = last_time;
+  nes_time_t time = osc.last_time;
   if (delta)
   {
     osc.last_amp += delta;
@@ -166,7 +183,7 @@ void Vrc6_Apu::run_saw(nes_time_t end_time)
 
   int amp = osc.amp;
   int amp_step = osc.regs[0] & 0x3F;
-  nes_time_t time = last_time;
+  nes_time_t time = osc.last_time;
   int last_amp = osc.last_amp;
   if (!(osc.regs[2] & 0x80) || !(amp_step | amp))
   {
@@ -6,6 +6,7 @@
 
 #include "../apu.hpp"
 #include "../blipBuffer.hpp"
+#include "../expansionApu.hpp"
 #include <stdint.h>
 
 namespace quickerNES
@@ -13,7 +14,7 @@ namespace quickerNES
 
 struct vrc6_apu_state_t;
 
-class Vrc6_Apu
+class Vrc6_Apu : public Expansion_Apu
 {
   public:
   Vrc6_Apu();
@@ -28,6 +29,7 @@ class Vrc6_Apu
   {
     osc_count = 3
   };
+  int channel_count() const { return osc_count; }
   void osc_output(int index, Blip_Buffer *);
   void end_frame(nes_time_t);
   void save_state(vrc6_apu_state_t *) const;
@@ -50,6 +52,12 @@ class Vrc6_Apu
   };
   void write_osc(nes_time_t, int osc, int reg, int data);
 
+  // Write at the address of the register, with its low two bits in the order above
+  void write_register(nes_time_t time, nes_addr_t addr, int data)
+  {
+    write_osc(time, (addr - base_addr) / addr_step, addr & 3, data);
+  }
+
   private:
   // noncopyable
   Vrc6_Apu(const Vrc6_Apu &);
@@ -63,6 +71,7 @@ class Vrc6_Apu
     int last_amp;
     int phase;
     int amp; // only used by saw
+    nes_time_t last_time;
 
     int period() const
     {
@@ -70,13 +79,15 @@ class Vrc6_Apu
     }
   };
 
+  // Each oscillator runs on its own, and only when one of its registers is written or the frame
+  // ends; a run split in two gives the same output as a single one.
   Vrc6_Osc oscs[osc_count];
-  nes_time_t last_time;
 
   Blip_Synth<blip_med_quality, 1> saw_synth;
   Blip_Synth<blip_good_quality, 1> square_synth;
 
   void run_until(nes_time_t);
+  void run_osc(int index, nes_time_t);
   void run_square(Vrc6_Osc &osc, nes_time_t);
   void run_saw(nes_time_t);
 };
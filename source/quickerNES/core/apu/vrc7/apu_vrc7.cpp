@@ -71,35 +71,45 @@ void Vrc7::output(Blip_Buffer *buf)
 
 void Vrc7::run_until(nes_time_t end_time)
 {
-  nes_time_t time = last_time;
+  nes_time_t const elapsed = end_time - last_time;
+  if (elapsed <= 0)
+  {
+    last_time = end_time;
+    return;
+  }
+
+  // The OPLL is only clocked while some channel has an output, every 36 cycles once count
+  // reaches 36. Without one, only count has to move.
+  e_uint32 mask = 0;
+  for (unsigned i = 0; i < osc_count; ++i)
+    if (oscs[i].output) mask |= OPLL_MASK_CH(i);
 
-  while (time < end_time)
+  if (count < 36)
   {
-    if (++count == 36)
+    for (nes_time_t time = last_time + 35 - count; mask && time < end_time; time += 36)
     {
-      count = 0;
-      bool run = false;
+      e_int32 amps[osc_count];
+      OPLL_runCh((OPLL *)opll, mask, amps);
       for (unsigned i = 0; i < osc_count; ++i)
       {
         Vrc7_Osc &osc = oscs[i];
         if (osc.output)
         {
-          if (!run)
-          {
-            run = true;
-            OPLL_run((OPLL *)opll);
-          }
-          int amp = OPLL_calcCh((OPLL *)opll, i);
-          int delta = amp - osc.last_amp;
+          int delta = amps[i] - osc.last_amp;
           if (delta)
           {
-            osc.last_amp = amp;
+            osc.last_amp = amps[i];
             synth.offset(time, delta, osc.output);
           }
         }
       }
     }
-    ++time;
+    count = (int)((count + elapsed) % 36);
+  }
+  else
+  {
+    // a snapshot's count past the period never wraps
+    count += (int)elapsed;
   }
 
   last_time = end_time;
@@ -5,6 +5,7 @@
 // Snd_Emu 0.1.7. Copyright (C) 2003-2005 Shay Green. GNU LGPL license.
 
 #include "../blipBuffer.hpp"
+#include "../expansionApu.hpp"
 #include "emu2413_state.hpp"
 #include <stdint.h>
 
@@ -12,9 +13,8 @@ namespace quickerNES
 {
 
 struct vrc7_snapshot_t;
-typedef long nes_time_t;
 
-class Vrc7
+class Vrc7 : public Expansion_Apu
 {
   public:
   Vrc7();
@@ -29,6 +29,7 @@ class Vrc7
   {
     osc_count = 6
   };
+  int channel_count() const { return osc_count; }
   void osc_output(int index, Blip_Buffer *);
   void end_frame(nes_time_t);
   void save_snapshot(vrc7_snapshot_t *);
@@ -38,6 +39,15 @@ class Vrc7
   void write_reg(int reg);
   void write_data(nes_time_t, int data);
 
+  // Register select at 0x9010, data at 0x9030
+  void write_register(nes_time_t time, nes_addr_t addr, int data)
+  {
+    if (addr & 0x20)
+      write_data(time, data);
+    else
+      write_reg(data);
+  }
+
   private:
   // noncopyable
   Vrc7(const Vrc7 &);
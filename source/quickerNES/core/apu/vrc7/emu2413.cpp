@@ -879,6 +879,29 @@ static INLINE e_int16 calc_ch(OPLL *opll, int ch)
     return 0;
 }
 
+/* Same as run() followed by calc_ch() for each channel in ch_mask. A channel's slots only
+   depend on each other, so each pair is stepped and calculated in one pass. */
+static INLINE void run_ch(OPLL *opll, e_uint32 ch_mask, e_int32 *out)
+{
+  e_int32 ch;
+
+  update_ampm(opll);
+
+  for (ch = 0; ch < 6; ch++)
+  {
+    OPLL_SLOT *mod = MOD(opll, ch);
+    OPLL_SLOT *car = CAR(opll, ch);
+
+    calc_phase(mod, opll->lfo_pm);
+    calc_envelope(opll, mod, opll->lfo_am);
+    calc_phase(car, opll->lfo_pm);
+    calc_envelope(opll, car, opll->lfo_am);
+
+    if (ch_mask & OPLL_MASK_CH(ch))
+      out[ch] = (car->eg_mode != FINISH) ? calc_slot_car(opll, car, calc_slot_mod(opll, mod)) : 0;
+  }
+}
+
 e_int16 OPLL_calc(OPLL *opll)
 {
   return calc(opll);
@@ -894,6 +917,11 @@ e_uint32 OPLL_calcCh(OPLL *opll, e_uint32 ch)
   return calc_ch(opll, ch);
 }
 
+void OPLL_runCh(OPLL *opll, e_uint32 ch_mask, e_int32 *out)
+{
+  run_ch(opll, ch_mask, out);
+}
+
 e_uint32
 OPLL_setMask(OPLL *opll, e_uint32 mask)
 {
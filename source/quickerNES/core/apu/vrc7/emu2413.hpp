@@ -208,6 +208,8 @@ extern "C"
   /* or */
   EMU2413_API void OPLL_run(OPLL *);
   EMU2413_API e_uint32 OPLL_calcCh(OPLL *, e_uint32 ch);
+  /* or both at once, for the channels in ch_mask */
+  EMU2413_API void OPLL_runCh(OPLL *, e_uint32 ch_mask, e_int32 *out);
 
   /* Misc */
   EMU2413_API void OPLL_forceRefresh(OPLL *);
@@ -0,0 +1,54 @@
+#pragma once
+
+// Log of the sound-relevant events of a frame
+
+#include "cpu.hpp"
+#include <stdint.h>
+#include <vector>
+
+namespace quickerNES
+{
+
+// Everything the APU and the mapper's sound chip see from the CPU: APU register writes, $4015
+// reads, expansion sound register accesses, and the bytes the DMC fetched, each with the time it
+// happened at. Another emulator holding the same state at the start of the frame can replay these
+// events (Core::replay_sound) to synthesize the frame's sound without running the CPU or PPU.
+// Storage is kept between frames, so logging only allocates while it grows.
+struct apu_log_t
+{
+  enum event_kind_t
+  {
+    apu_write,   // CPU write to $4000-$4017, other than $4014 and $4016
+    status_read, // CPU read of $4015
+    sound_write, // Expansion_Apu::write_register
+    sound_read   // Expansion_Apu::read_register
+  };
+
+  struct event_t
+  {
+    int32_t time;
+    uint8_t kind;
+    uint8_t data;
+    uint16_t addr;
+  };
+
+  std::vector<event_t> events;
+  std::vector<uint8_t> dmc_data; // bytes read by the DMC, in order
+  nes_time_t frame_length = 0;   // frame length returned by emulate_frame; zero while in progress
+  nes_time_t end_time = 0;       // CPU time the frame ended at, which the mapper ends its frame at
+
+  void clear()
+  {
+    events.clear();
+    dmc_data.clear();
+    frame_length = 0;
+    end_time = 0;
+  }
+
+  void add(event_kind_t kind, nes_time_t time, unsigned addr, int data)
+  {
+    events.push_back(event_t{(int32_t)time, (uint8_t)kind, (uint8_t)data, (uint16_t)addr});
+  }
+};
+
+} // namespace quickerNES
@@ -15,6 +15,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 
 // Emu 0.7.0. http://www.slack.net/~ant/
 
+#include "ppu/tileCache.hpp"
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -177,7 +178,7 @@ class Cart
       bufferPos += copySize;
     }
 
-    return nullptr;
+    return tile_cache_.init(chr_, chr_size_);
   }
 
   inline bool has_battery_ram() const { return mapper & 0x02; }
@@ -210,13 +211,17 @@ class Cart
   inline uint8_t *chr() { return chr_; }
   inline uint8_t const *chr() const { return chr_; }
 
+  // Decoded CHR ROM tiles, shared by every emulator using this cartridge
+  Tile_Cache *tile_cache() const { return &tile_cache_; }
+
   // End of public interface
   private:
-  uint8_t *prg_;
-  uint8_t *chr_;
-  long prg_size_;
-  long chr_size_;
+  uint8_t *prg_ = nullptr;
+  uint8_t *chr_ = nullptr;
+  long prg_size_ = 0;
+  long chr_size_ = 0;
   unsigned mapper;
+  mutable Tile_Cache tile_cache_;
 };
 
 } // namespace quickerNES
@@ -16,9 +16,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 // Emu 0.7.0
 
 #include "apu/apu.hpp"
+#include "apu/expansionApu.hpp"
+#include "apuLog.hpp"
 #include "cpu.hpp"
 #include "mappers/mapper.hpp"
 #include "ppu/ppu.hpp"
+#include "ppuLog.hpp"
+#include "watches.hpp"
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <jaffarCommon/deserializers/base.hpp>
@@ -28,10 +33,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 #include <stdexcept>
 #include <string>
 
-#ifdef _QUICKERNES_ENABLE_INPUT_CALLBACK
-extern void (*input_callback_cb)(void);
-#endif
-
 namespace quickerNES
 {
 
@@ -142,6 +143,7 @@ class Core : private Cpu
       memset(impl->sram, 0xFF, impl->sram_size);
       impl->apu.dmc_reader(read_dmc, this);
       impl->apu.irq_notifier(apu_irq_changed, this);
+      NES_STAT(impl->apu.stats = &stats);
       memset(impl->unmapped_page, unmapped_fill, sizeof impl->unmapped_page);
     }
 
@@ -159,7 +161,8 @@ class Core : private Cpu
     auto mapperCode = new_cart->mapper_code();
 
     // Getting mapper corresponding to that code
-    mapper = Mapper::getMapperFromCode(mapperCode);
+    const mapper_info_t *mapperInfo = Mapper::getMapperInfo(mapperCode);
+    if (mapperInfo != nullptr) mapper = mapperInfo->create();
 
     // If no mapper was found, return null (error) now
     if (mapper == nullptr)
@@ -167,12 +170,14 @@ class Core : private Cpu
       fprintf(stderr, "Could not find mapper for code: %u\n", mapperCode);
       return "Unsupported mapper";
     }
+    mapper_caps = mapperInfo->caps;
+    sound_chip = mapper->sound_chip();
 
     // Assigning backwards pointers to cartdrige and emulator now
     mapper->cart_ = new_cart;
     mapper->emu_ = this;
 
-    error = ppu.open_chr(new_cart->chr(), new_cart->chr_size());
+    error = ppu.open_chr(new_cart->chr(), new_cart->chr_size(), new_cart->tile_cache());
     if (error) return error;
 
     cart = new_cart;
@@ -184,6 +189,9 @@ class Core : private Cpu
 
   inline void serializeState(jaffarCommon::serializer::Base &serializer) const
   {
+    // A frame stopped by a watch is only partly in the state
+    if (frame_in_progress()) throw std::logic_error("State can't be saved while a frame stopped by a watch is in progress");
+
     // TIME Block
     if (TIMEBlockEnabled == true)
     {
@@ -224,6 +232,7 @@ class Core : private Cpu
     if (APURBlockEnabled == true)
     {
       Apu::apu_state_t apuState;
+      memset(&apuState, 0, sizeof apuState);
       impl->apu.save_state(&apuState);
 
       const auto inputDataSize = sizeof(Apu::apu_state_t);
@@ -296,6 +305,8 @@ class Core : private Cpu
 
   inline void deserializeState(jaffarCommon::deserializer::Base &deserializer)
   {
+    if (frame_in_progress()) throw std::logic_error("State can't be loaded while a frame stopped by a watch is in progress");
+
     disable_rendering();
     error_count = 0;
     ppu.burst_phase = 0; // avoids shimmer when seeking to same time over and over
@@ -397,11 +408,11 @@ class Core : private Cpu
     {
       if (ppu.chr_is_writable)
       {
-        const auto outputData = (uint8_t *)ppu.impl->chr_ram;
+        uint8_t inputData[sizeof ppu.impl->chr_ram];
         const auto inputDataSize = ppu.chr_size;
-        deserializer.pop(outputData, inputDataSize);
+        deserializer.pop(inputData, inputDataSize);
 
-        ppu.all_tiles_modified();
+        ppu.load_chr_ram(inputData);
       }
     }
 
@@ -608,21 +619,40 @@ class Core : private Cpu
 
   nes_time_t emulate_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arkanoid_latch, uint8_t arkanoid_fire)
   {
-#ifdef _QUICKERNES_DETECT_JOYPAD_READS
-    joypad_read_count = 0;
-#endif
-
     current_joypad[0] = joypad1;
     current_joypad[1] = joypad2;
     current_arkanoid_latch = arkanoid_latch;
     current_arkanoid_fire = arkanoid_fire;
 
+    // A frame stopped by a watch continues with the new inputs
+    if (watch_stopped) return resume_frame();
+
+#ifdef _QUICKERNES_DETECT_JOYPAD_READS
+    joypad_read_count = 0;
+#endif
+
+    NES_STAT(stats = frame_stats_t());
+    if (ppu_log) ppu_log->clear();
+    if (apu_log) apu_log->clear();
+
     cpu_time_offset = ppu.begin_frame(nes.timestamp) - 1;
     ppu_2002_time = 0;
     clock_ = cpu_time_offset;
 
+    if (watches_active) arm_scanline_watches();
+
+    return resume_frame();
+  }
+
+  // Continues a frame that was stopped by a watch. Returns the frame length once the frame
+  // completes, or zero if another watch stopped it first.
+  nes_time_t resume_frame()
+  {
+    watch_triggered = -1;
+
     // TODO: clean this fucking mess up
     auto t0 = emulate_frame_();
+    if (watch_stopped) return 0;
     impl->apu.run_until_(t0);
     clock_ = cpu_time_offset;
     auto t1 = cpu_time();
@@ -630,22 +660,204 @@ class Core : private Cpu
 
     nes_time_t ppu_frame_length = ppu.frame_length();
     nes_time_t length = cpu_time();
+    if (ppu_log) ppu_log->frame_length = length;
+    if (apu_log)
+    {
+      apu_log->frame_length = ppu_frame_length;
+      apu_log->end_time = length;
+    }
     nes.timestamp = ppu.end_frame(length);
-    mapper->end_frame(length);
+    end_mapper_frame(length);
 
     impl->apu.end_frame(ppu_frame_length);
 
     disable_rendering();
     nes.frame_count++;
 
+    if (watches_active) rebase_cycle_watches(ppu_frame_length);
+
     return ppu_frame_length;
   }
 
+  // Run-until-condition watches. Each returns the watch index, or -1 if the watch table is full.
+  // While any watch is active, emulate_frame() may return early (zero) with the frame still in
+  // progress; resume_frame() continues from the exact stop point. States can only be saved or
+  // loaded at frame boundaries; serializeState() and deserializeState() throw std::logic_error
+  // while a frame is in progress.
+  int add_pc_watch(nes_addr_t addr)
+  {
+    watch_t w = {watch_t::pc_reached, addr, -1, 0, 0, false};
+    return add_watch(w);
+  }
+
+  int add_ram_write_watch(nes_addr_t addr, int value = -1)
+  {
+    watch_t w = {watch_t::ram_written, addr & (low_ram_size - 1), value, 0, 0, false};
+    return add_watch(w);
+  }
+
+  int add_scanline_watch(int scanline)
+  {
+    watch_t w = {watch_t::scanline_started, 0, -1, scanline, 0, false};
+    int index = add_watch(w);
+    if (index >= 0) arm_scanline_watch(watches->watches[index], watch_present());
+    return index;
+  }
+
+  int add_cycle_watch(nes_time_t cycles)
+  {
+    watch_t w = {watch_t::cycles_elapsed, 0, -1, 0, watch_present() + cycles, true};
+    return add_watch(w);
+  }
+
+  void clear_watches()
+  {
+    if (watches) watches->clear();
+    watches_active = false;
+    watch_skip_check = false;
+    watch_triggered = -1;
+  }
+
+  // Index of the watch that stopped emulation last, or -1
+  int triggered_watch() const { return watch_triggered; }
+
+  // Whether the current frame was stopped by a watch and still needs resume_frame()
+  bool frame_in_progress() const { return watch_stopped; }
+
+  // Log receiving the PPU-visible events of each frame, or NULL. Cleared when a frame begins.
+  ppu_log_t *ppu_log = nullptr;
+
+  // Runs the PPU through a frame logged by another core, which had the same state at the start of
+  // the frame as this one has now. The CPU, APU and mapper are not run; only the PPU (and with it,
+  // the image) and the frame timing advance. Returns the frame length like emulate_frame().
+  nes_time_t replay_frame(ppu_log_t const &log)
+  {
+    cpu_time_offset = ppu.begin_frame(nes.timestamp) - 1;
+    ppu_2002_time = 0;
+
+    for (const auto &e : log.events)
+    {
+      nes_time_t time = e.time;
+      switch (e.kind)
+      {
+      case ppu_log_t::reg_write:
+        if ((e.addr & 7) == 7)
+          cpu_write_2007(e.data, time - cpu_time_offset);
+        else
+          ppu.write(time, e.addr, e.data);
+        break;
+
+      case ppu_log_t::reg_read:
+        ppu.read(e.addr, time);
+        break;
+
+      case ppu_log_t::status_read:
+        ppu.second_write = false;
+        if (e.data) ppu.read_2002(time);
+        break;
+
+      case ppu_log_t::sprite_dma:
+        ppu.dma_sprites(time, &log.sprite_data[e.value]);
+        break;
+
+      case ppu_log_t::chr_bank:
+        ppu.render_until(time);
+        ppu.set_chr_bank(e.addr, 1 << e.data, e.value);
+        break;
+
+      case ppu_log_t::chr_bank_ex:
+        ppu.render_until(time);
+        ppu.set_chr_bank_ex(e.addr, 1 << e.data, e.value);
+        break;
+
+      case ppu_log_t::nt_banks:
+        ppu.render_bg_until(time);
+        ppu.set_nt_banks(e.value & 0xFF, e.value >> 8 & 0xFF, e.value >> 16 & 0xFF, e.value >> 24 & 0xFF);
+        break;
+
+      case ppu_log_t::bg_catch_up:
+        ppu.render_bg_until(time);
+        break;
+      }
+    }
+
+    nes_time_t ppu_frame_length = ppu.frame_length();
+    nes.timestamp = ppu.end_frame(log.frame_length);
+    end_mapper_frame(log.frame_length);
+
+    disable_rendering();
+    nes.frame_count++;
+
+    return ppu_frame_length;
+  }
+
+  // Log receiving the sound-relevant events of each frame, or NULL. Cleared when a frame begins.
+  apu_log_t *apu_log = nullptr;
+
+  // Runs the APU and the mapper's sound chip through a frame logged by another core, which had the
+  // same state at the start of the frame as this one has now. Nothing else is run, so only the
+  // sound state advances. Returns the frame length like emulate_frame().
+  nes_time_t replay_sound(apu_log_t const &log)
+  {
+    Apu &apu = impl->apu;
+    dmc_replay_t dmc = {log.dmc_data.data(), log.dmc_data.data() + log.dmc_data.size()};
+    apu.dmc_reader(replay_dmc, &dmc);
+
+    for (const auto &e : log.events)
+    {
+      switch (e.kind)
+      {
+      case apu_log_t::apu_write:
+        apu.write_register(e.time, e.addr, e.data);
+        break;
+
+      case apu_log_t::status_read:
+        apu.read_status(e.time);
+        break;
+
+      case apu_log_t::sound_write:
+        sound_chip->write_register(e.time, e.addr, e.data);
+        break;
+
+      case apu_log_t::sound_read:
+        sound_chip->read_register(e.time, e.addr);
+        break;
+      }
+    }
+
+    apu.run_until_(log.end_time);
+    end_mapper_frame(log.end_time);
+    apu.end_frame(log.frame_length);
+
+    apu.dmc_reader(read_dmc, this);
+    return log.frame_length;
+  }
+
+  // Makes this core read the states another core writes, as states only hold the blocks enabled
+  // when they were saved
+  void copy_state_layout(Core const &from)
+  {
+    _NTABBlockSize = from._NTABBlockSize;
+    _SRAMBlockSize = from._SRAMBlockSize;
+    TIMEBlockEnabled = from.TIMEBlockEnabled;
+    CPURBlockEnabled = from.CPURBlockEnabled;
+    PPURBlockEnabled = from.PPURBlockEnabled;
+    APURBlockEnabled = from.APURBlockEnabled;
+    CTRLBlockEnabled = from.CTRLBlockEnabled;
+    MAPRBlockEnabled = from.MAPRBlockEnabled;
+    LRAMBlockEnabled = from.LRAMBlockEnabled;
+    SPRTBlockEnabled = from.SPRTBlockEnabled;
+    NTABBlockEnabled = from.NTABBlockEnabled;
+    CHRRBlockEnabled = from.CHRRBlockEnabled;
+    SRAMBlockEnabled = from.SRAMBlockEnabled;
+  }
+
   void close()
   {
     cart = NULL;
     delete mapper;
     mapper = NULL;
+    sound_chip = NULL;
 
     ppu.close_chr();
 
@@ -659,7 +871,9 @@ class Core : private Cpu
 
   void event_changed()
   {
-    cpu_set_end_time(earliest_event(cpu_time()));
+    nes_time_t end_time = earliest_event(cpu_time());
+    if (watches_active) [[unlikely]] end_time = watch_event_end_time(end_time);
+    cpu_set_end_time(end_time);
   }
 
   public:
@@ -689,6 +903,8 @@ class Core : private Cpu
   uint8_t current_arkanoid_fire;
   Cart const *cart;
   Mapper *mapper;
+  unsigned mapper_caps = 0; // mapper_caps_t flags of the mapper
+  Expansion_Apu *sound_chip = nullptr; // the mapper's sound chip, or NULL
   nes_state_t nes;
   Ppu ppu;
   int joypad_read_count = 0;
@@ -702,8 +918,16 @@ class Core : private Cpu
   nes_time_t ppu_2002_time;
   void disable_rendering() { clock_ = 0; }
 
+  // Ends the frame of the mapper and of its sound chip
+  inline void end_mapper_frame(nes_time_t end_time)
+  {
+    if (mapper_caps & mapper_end_frame) mapper->end_frame(end_time);
+    if (sound_chip) sound_chip->end_frame(end_time);
+  }
+
   inline nes_time_t earliest_irq(nes_time_t present)
   {
+    if (!(mapper_caps & mapper_irq)) return impl->apu.earliest_irq(present);
     return std::min(impl->apu.earliest_irq(present), mapper->next_irq(present));
   }
 
@@ -713,6 +937,7 @@ class Core : private Cpu
     if (t > present)
       return t;
 
+    if (ppu_log) ppu_log->add(ppu_log_t::bg_catch_up, clock(), 0, 0);
     ppu.render_bg_until(clock()); // to do: why this call to clock() rather than using present?
     return ppu.frame_length();
   }
@@ -742,6 +967,18 @@ class Core : private Cpu
 
   void setControllerType(controllerType_t type) { _controllerType = type; }
 
+#ifdef _QUICKERNES_ENABLE_INPUT_CALLBACK
+  // Called whenever the joypads get latched. Kept per instance so that several emulators can run concurrently.
+  void (*input_callback_cb)(void *context) = nullptr;
+  void *input_callback_context = nullptr;
+
+  void set_input_callback(void (*cb)(void *context), void *context)
+  {
+    input_callback_cb = cb;
+    input_callback_context = context;
+  }
+#endif
+
 #ifdef _QUICKERNES_SUPPORT_ARKANOID_INPUTS
   int read_io(nes_addr_t addr)
   {
@@ -812,7 +1049,10 @@ class Core : private Cpu
 
 
     if (addr == Apu::status_addr)
+    {
+      if (apu_log) apu_log->add(apu_log_t::status_read, clock(), addr, 0);
       return impl->apu.read_status(clock());
+    }
 
     return addr >> 8; // simulate open bus
   }
@@ -831,7 +1071,10 @@ class Core : private Cpu
     }
 
     if (addr == Apu::status_addr)
+    {
+      if (apu_log) apu_log->add(apu_log_t::status_read, clock(), addr, 0);
       return impl->apu.read_status(clock());
+    }
 
     return addr >> 8; // simulate open bus
   }
@@ -842,6 +1085,7 @@ class Core : private Cpu
     // sprite dma
     if (addr == 0x4014)
     {
+      if (ppu_log) ppu_log->add_sprite_dma(clock(), cpu::get_code(data * 0x100));
       ppu.dma_sprites(clock(), cpu::get_code(data * 0x100));
       cpu_adjust_time(513);
       return;
@@ -862,7 +1106,7 @@ class Core : private Cpu
         #endif
 
 		#ifdef _QUICKERNES_ENABLE_INPUT_CALLBACK
-        input_callback_cb();
+        if (input_callback_cb != nullptr) input_callback_cb(input_callback_context);
 		#endif
       }
       input_state.w4016 = data;
@@ -872,6 +1116,7 @@ class Core : private Cpu
     // apu
     if (unsigned(addr - impl->apu.start_addr) <= impl->apu.end_addr - impl->apu.start_addr)
     {
+      if (apu_log) apu_log->add(apu_log_t::apu_write, clock(), addr, data);
       impl->apu.write_register(clock(), addr, data);
       if (wait_states_enabled)
       {
@@ -889,11 +1134,26 @@ class Core : private Cpu
   {
     Core *emu = (Core *)data;
     int result = *emu->cpu::get_code(addr);
+    if (emu->apu_log) emu->apu_log->dmc_data.push_back(result);
+    NES_STAT(emu->stats.dmc_reads++);
     if (wait_states_enabled)
       emu->cpu_adjust_time(4);
     return result;
   }
 
+  // DMC reader for replay_sound(), returning the bytes the logging core read
+  struct dmc_replay_t
+  {
+    uint8_t const *next;
+    uint8_t const *end;
+  };
+
+  static int replay_dmc(void *data, nes_addr_t)
+  {
+    dmc_replay_t *dmc = (dmc_replay_t *)data;
+    return dmc->next < dmc->end ? *dmc->next++ : 0;
+  }
+
   static inline void apu_irq_changed(void *emu)
   {
     ((Core *)emu)->irq_changed();
@@ -910,6 +1170,22 @@ class Core : private Cpu
   {
     Cpu::result_t last_result = cpu::result_cycles;
     int extra_instructions = 0;
+    nes_time_t present;
+
+    // Resuming from a watch stop
+    if (watch_stopped) [[unlikely]]
+    {
+      watch_stopped = false;
+      last_result = watch_last_result;
+      extra_instructions = watch_extra_instructions;
+      if (watch_resume_at_cpu)
+      {
+        present = cpu_time();
+        watch_skip_check = true;
+        goto run_cpu;
+      }
+    }
+
     while (true)
     {
       // Add DMC wait-states to CPU time
@@ -919,7 +1195,7 @@ class Core : private Cpu
         clock_ = cpu_time_offset;
       }
 
-      nes_time_t present = cpu_time();
+      present = cpu_time();
       if (present >= ppu_frame_length(present))
       {
         if (ppu.nmi_time() <= present)
@@ -932,6 +1208,7 @@ class Core : private Cpu
           {
             /* vectored NMI at end of frame */
             vector_interrupt(0xFFFA);
+            NES_STAT(stats.nmis++);
             present += 7;
           }
           return present;
@@ -955,38 +1232,193 @@ class Core : private Cpu
       {
         ppu.acknowledge_nmi();
         vector_interrupt(0xFFFA);
+        NES_STAT(stats.nmis++);
         last_result = cpu::result_cycles; // most recent sei/cli won't be delayed now
       }
 
       // IRQ
-      nes_time_t irq_time = earliest_irq(present);
-      cpu_set_irq_time(irq_time);
-      if (present >= irq_time && (!(cpu::r.status & irq_inhibit_mask) ||
-                                  last_result == cpu::result_sei))
       {
-        if (last_result != cpu::result_cli)
-        {
-          /* IRQ vectored */
-          mapper->run_until(present);
-          vector_interrupt(0xFFFE);
-        }
-        else
+        nes_time_t irq_time = earliest_irq(present);
+        cpu_set_irq_time(irq_time);
+        if (present >= irq_time && (!(cpu::r.status & irq_inhibit_mask) ||
+                                    last_result == cpu::result_sei))
         {
-          // CLI delays IRQ
-          cpu_set_irq_time(present + 1);
+          if (last_result != cpu::result_cli)
+          {
+            /* IRQ vectored */
+            if (mapper_caps & mapper_irq) mapper->run_until(present);
+            vector_interrupt(0xFFFE);
+            NES_STAT(stats.irqs++);
+          }
+          else
+          {
+            // CLI delays IRQ
+            cpu_set_irq_time(present + 1);
+          }
         }
       }
 
+    run_cpu:
       // CPU
       nes_time_t end_time = earliest_event(present);
       if (extra_instructions)
         end_time = present + 1;
+
+      if (watches_active) [[unlikely]]
+      {
+        if (check_watches_before_cpu(present))
+        {
+          watch_stop(last_result, extra_instructions, true);
+          return present;
+        }
+        end_time = watch_end_time(present, end_time);
+      }
+
       unsigned long cpu_error_count = cpu::error_count();
       last_result = NES_EMU_CPU_HOOK(cpu, end_time - cpu_time_offset - 1);
       cpu_adjust_time(cpu::time());
       clock_ = cpu_time_offset;
       error_count += cpu::error_count() - cpu_error_count;
+
+      if (watches_active) [[unlikely]]
+      {
+        if (check_watches_after_cpu())
+        {
+          watch_stop(last_result, extra_instructions, false);
+          return cpu_time();
+        }
+      }
+    }
+  }
+
+  // Watches
+
+  std::unique_ptr<Watch_Table> watches;
+  bool watches_active = false;
+  bool watch_stopped = false;
+  bool watch_resume_at_cpu = false;
+  bool watch_skip_check = false;
+  int watch_triggered = -1;
+  Cpu::result_t watch_last_result;
+  int watch_extra_instructions;
+
+  int add_watch(const watch_t &w)
+  {
+    if (!watches) watches.reset(new (std::nothrow) Watch_Table);
+    if (!watches) return -1;
+    int index = watches->add(w);
+    if (index >= 0) watches_active = true;
+    return index;
+  }
+
+  // Current CPU time, or the time the next frame will start at when called between frames
+  nes_time_t watch_present() const { return watch_stopped ? cpu_time() : nes.timestamp / ppu_overclock; }
+
+  void arm_scanline_watch(watch_t &w, nes_time_t present)
+  {
+    w.time = ppu.scanline_start_time(w.scanline);
+    w.armed = w.time >= present;
+  }
+
+  void arm_scanline_watches()
+  {
+    for (int i = 0; i < watches->count; i++)
+      if (watches->watches[i].type == watch_t::scanline_started)
+        arm_scanline_watch(watches->watches[i], cpu_time());
+  }
+
+  void rebase_cycle_watches(nes_time_t frame_length)
+  {
+    for (int i = 0; i < watches->count; i++)
+      if (watches->watches[i].type == watch_t::cycles_elapsed)
+        watches->watches[i].time -= frame_length;
+  }
+
+  void watch_stop(Cpu::result_t last_result, int extra_instructions, bool resume_at_cpu)
+  {
+    watch_stopped = true;
+    watch_resume_at_cpu = resume_at_cpu;
+    watch_last_result = last_result;
+    watch_extra_instructions = extra_instructions;
+  }
+
+  // Checks the watches that stop emulation before the next instruction executes
+  bool check_watches_before_cpu(nes_time_t present)
+  {
+    // The instruction a resumed frame stopped at must not trigger again
+    if (watch_skip_check)
+    {
+      watch_skip_check = false;
+      return false;
+    }
+
+    for (int i = 0; i < watches->count; i++)
+    {
+      watch_t &w = watches->watches[i];
+      if (w.armed && present >= w.time)
+      {
+        w.armed = false;
+        watch_triggered = i;
+        return true;
+      }
+    }
+
+    if (watches->step && watches->pc_watched(cpu::r.pc))
+    {
+      for (int i = 0; i < watches->count; i++)
+        if (watches->watches[i].type == watch_t::pc_reached && watches->watches[i].addr == cpu::r.pc)
+          watch_triggered = i;
+      return true;
+    }
+
+    return false;
+  }
+
+  // CPU end time after an event changed mid-slice, which must not run past the stop the watches
+  // set when the slice began
+  nes_time_t watch_event_end_time(nes_time_t end_time)
+  {
+    if (watches->step) return cpu_time() + 1;
+    return watches->next_timed(end_time);
+  }
+
+  // Lowers the CPU end time so that timed watches are reached, and single-steps the CPU while
+  // PC or RAM watches are present
+  nes_time_t watch_end_time(nes_time_t present, nes_time_t end_time)
+  {
+    end_time = watches->next_timed(end_time);
+    if (!watches->step) return end_time;
+
+    if (watches->ram_count)
+    {
+      for (int i = 0; i < watches->ram_count; i++)
+        watches->ram_before[i] = cpu::low_mem[watches->watches[watches->ram_index[i]].addr];
+      watches->write_count = decode_ram_writes(*this, watches->write_addr);
     }
+
+    return std::min(end_time, present + 1);
+  }
+
+  // Checks the watches that stop emulation after an instruction executes
+  bool check_watches_after_cpu()
+  {
+    for (int i = 0; i < watches->ram_count; i++)
+    {
+      const watch_t &w = watches->watches[watches->ram_index[i]];
+      const int value = cpu::low_mem[w.addr];
+
+      bool written = value != watches->ram_before[i];
+      for (int j = 0; j < watches->write_count; j++)
+        if (watches->write_addr[j] == (int)w.addr) written = true;
+
+      if (written && (w.value < 0 || w.value == value))
+      {
+        watch_triggered = watches->ram_index[i];
+        return true;
+      }
+    }
+
+    return false;
   }
 
   nes_addr_t read_vector(nes_addr_t addr)
@@ -1075,7 +1507,7 @@ class Core : private Cpu
   int cpu_read_ppu(nes_addr_t, nes_time_t);
   int cpu_read(nes_addr_t, nes_time_t);
   void cpu_write(nes_addr_t, int data, nes_time_t);
-  void cpu_write_2007(int data);
+  void cpu_write_2007(int data, nes_time_t);
 
   private:
   unsigned char data_reader_mapped[page_count + 1]; // extra entry for overflow
@@ -1098,7 +1530,10 @@ inline int Core::cpu_read(nes_addr_t addr, nes_time_t time)
 
   time += cpu_time_offset;
   if (addr < 0x4000)
+  {
+    if (ppu_log) ppu_log->add(ppu_log_t::reg_read, time, addr, 0);
     return ppu.read(addr, time);
+  }
 
   clock_ = time;
   if (data_reader_mapped[addr >> page_bits])
@@ -1130,6 +1565,8 @@ inline int Core::cpu_read_ppu(nes_addr_t addr, nes_time_t time)
   int result = ppu.r2002;
   if (addr == 0x2002)
   {
+    if (ppu_log && (ppu.second_write || time >= next))
+      ppu_log->add(ppu_log_t::status_read, time + cpu_time_offset, addr, time >= next);
     ppu.second_write = false;
     if (time >= next)
       result = ppu.read_2002(time + cpu_time_offset);
@@ -1144,10 +1581,12 @@ inline int Core::cpu_read_ppu(nes_addr_t addr, nes_time_t time)
   return result;
 }
 
-inline void Core::cpu_write_2007(int data)
+inline void Core::cpu_write_2007(int data, nes_time_t time)
 {
+  if (ppu_log) ppu_log->add(ppu_log_t::reg_write, time + cpu_time_offset, 0x2007, data);
+
   // ppu.write_2007() is inlined
-  if (ppu.write_2007(data) & Ppu::vaddr_clock_mask)
+  if ((ppu.write_2007(data) & Ppu::vaddr_clock_mask) && (mapper_caps & mapper_a12))
     mapper->a12_clocked();
 }
 
@@ -1161,19 +1600,27 @@ inline void Core::cpu_write(nes_addr_t addr, int data, nes_time_t time)
     return;
   }
 
-  time += cpu_time_offset;
   if (addr < 0x4000)
   {
     if ((addr & 7) == 7)
-      cpu_write_2007(data);
-    else
-      ppu.write(time, addr, data);
+    {
+      cpu_write_2007(data, time);
+      return;
+    }
+    time += cpu_time_offset;
+    if (ppu_log) ppu_log->add(ppu_log_t::reg_write, time, addr, data);
+    ppu.write(time, addr, data);
     return;
   }
 
+  time += cpu_time_offset;
+
   clock_ = time;
   if (data_writer_mapped[addr >> page_bits] && mapper->write_intercepted(time, addr, data))
+  {
+    NES_STAT(stats.mapper_writes++);
     return;
+  }
 
   if (addr < 0x6000)
   {
@@ -1189,6 +1636,7 @@ inline void Core::cpu_write(nes_addr_t addr, int data, nes_time_t time)
 
   if (addr > 0x7FFF)
   {
+    NES_STAT(stats.mapper_writes++);
     mapper->write(clock_, addr, data);
     return;
   }
@@ -1210,7 +1658,7 @@ inline void Core::cpu_write(nes_addr_t addr, int data, nes_time_t time)
     if (addr < 0x800)                                        \
       cpu->low_mem[addr] = data;                             \
     else if (addr == 0x2007)                                 \
-      static_cast<Core &>(*cpu).cpu_write_2007(data);        \
+      static_cast<Core &>(*cpu).cpu_write_2007(data, time);  \
     else                                                     \
       static_cast<Core &>(*cpu).cpu_write(addr, data, time); \
   }
@@ -3,6 +3,7 @@
 // NES 6502 CPU emulator
 // Emu 0.7.0
 
+#include "stats.hpp"
 #include <stdint.h>
 #include <string.h>
 #include <limits.h>
@@ -63,6 +64,16 @@ class Cpu
       set_code_page(first_page + i, (uint8_t *)data + i * page_size);
   }
 
+  // True if the range is already mapped to data, so mapping it again would change nothing
+  inline bool code_mapped(nes_addr_t start, unsigned size, const void *data) const
+  {
+    unsigned first_page = start / page_size;
+    for (unsigned i = size / page_size; i--;)
+      if (code_map[first_page + i] != (uint8_t const *)data - first_page * page_size)
+        return false;
+    return true;
+  }
+
   inline void flattenCodePages()
   {
     for (unsigned int i = 0; i < page_count + 1; i++)
@@ -176,6 +187,10 @@ class Cpu
   registers_t r;
   bool isCorrectExecution = true;
 
+#ifdef _QUICKERNES_ENABLE_STATS
+  frame_stats_t stats;
+#endif
+
   // low_mem is a full page size so it can be mapped with code_map
   uint8_t low_mem[page_size > 0x800 ? page_size : 0x800];
 
@@ -232,6 +232,8 @@ loop:
   if (clock_count >= clock_limit) [[unlikely]]
     goto stop;
 
+  NES_STAT(stats.cpu_instructions++);
+
 // If traceback support is enabled, trigger it here
 #ifdef _QUICKERNES_ENABLE_TRACEBACK_SUPPORT
   if (tracecb)
@@ -1202,6 +1204,8 @@ end:
   r.y = y;
   irq_time_ = LONG_MAX / 2 + 1;
 
+  NES_STAT(stats.cpu_runs++; stats.cpu_results[result]++; stats.cpu_cycles += clock_count;)
+
   return result;
 }
 
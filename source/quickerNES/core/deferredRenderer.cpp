@@ -0,0 +1,161 @@
+// Deferred rendering of an emulator's frames on a separate thread
+
+#include "deferredRenderer.hpp"
+#include "core.hpp"
+#include "emu.hpp"
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <utility>
+
+namespace quickerNES
+{
+
+Deferred_Renderer::~Deferred_Renderer()
+{
+  if (!source) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  worker.join();
+  source->set_ppu_log(NULL);
+}
+
+const char *Deferred_Renderer::init(Emu *source_, Emu *output_, int history_size_, int keyframe_interval_)
+{
+  if (source) return "Deferred renderer already initialized";
+  if (source_->cart() != output_->cart()) return "Output must use the same cartridge as the source";
+  int mapper = source_->cart()->mapper_code();
+  if (mapper == 9 || mapper == 10) return "Deferred rendering doesn't support CHR latches (MMC2/MMC4)";
+  if (history_size_ < 0 || keyframe_interval_ < 1) return "Invalid history parameters";
+
+  source = source_;
+  output = output_;
+  history_size = history_size_;
+  keyframe_interval = keyframe_interval_;
+  history.resize(history_size);
+  sync();
+  worker = std::thread(&Deferred_Renderer::run_worker, this);
+  return 0;
+}
+
+void Deferred_Renderer::sync()
+{
+  wait();
+  save_keyframe();
+  load_state(output, source->emu, next_keyframe);
+  logs[logging].clear();
+  source->set_ppu_log(&logs[logging]);
+}
+
+const char *Deferred_Renderer::end_frame()
+{
+  ppu_log_t &log = logs[logging];
+  if (!log.frame_length) return "No complete frame emulated since the last one handed over";
+
+  const char *error = wait();
+
+  // The frame's log and keyframe are swapped into the oldest record, whose storage the source then
+  // logs and saves keyframes into, so nothing is allocated once the records have grown
+  ppu_log_t *handed_over = &log;
+  if (history_size)
+  {
+    if (history_count < history_size)
+      history_count++;
+    else
+      history_first = (history_first + 1) % history_size;
+
+    record_t &record = history_at(history_count - 1);
+    record.frame = frames;
+    std::swap(record.log, log);
+    record.keyframe.swap(next_keyframe);
+    next_keyframe.clear();
+    handed_over = &record.log;
+  }
+
+  frames++;
+  if (frames % keyframe_interval == 0) save_keyframe();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = handed_over;
+  }
+  cond.notify_all();
+
+  logging ^= 1;
+  logs[logging].clear();
+  source->set_ppu_log(&logs[logging]);
+  return error;
+}
+
+const char *Deferred_Renderer::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this] { return pending == NULL; });
+  const char *error = worker_error;
+  worker_error = NULL;
+  return error;
+}
+
+const char *Deferred_Renderer::render_frame(uint64_t frame, Emu *out)
+{
+  if (out == output) return "Cannot render again into the output emulator";
+  if (out->cart() != source->cart()) return "Emulator must use the same cartridge as the source";
+  if (!history_count || frame < history_at(0).frame || frame >= frames) return "Frame not in history";
+
+  // Start from the closest keyframe before the frame
+  size_t last = frame - history_at(0).frame;
+  size_t first = last;
+  while (history_at(first).keyframe.empty())
+  {
+    if (first == 0) return "Frame not in history";
+    first--;
+  }
+
+  load_state(out, source->emu, history_at(first).keyframe);
+  for (size_t i = first; i < last; i++)
+  {
+    const char *error = out->replay_frame(history_at(i).log, false);
+    if (error) return error;
+  }
+  return out->replay_frame(history_at(last).log);
+}
+
+void Deferred_Renderer::run_worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    cond.wait(lock, [this] { return pending != NULL || quit; });
+    if (quit) return;
+
+    ppu_log_t const *log = pending;
+    lock.unlock();
+    const char *error = output->replay_frame(*log);
+    lock.lock();
+
+    if (error) worker_error = error;
+    pending = NULL;
+    cond.notify_all();
+  }
+}
+
+void Deferred_Renderer::save_keyframe()
+{
+  jaffarCommon::serializer::Contiguous size;
+  source->serializeState(size);
+  next_keyframe.resize(size.getOutputSize());
+  jaffarCommon::serializer::Contiguous s(next_keyframe.data(), next_keyframe.size());
+  source->serializeState(s);
+}
+
+void Deferred_Renderer::load_state(Emu *to, Core const &from, std::vector<uint8_t> const &state)
+{
+  to->emu.copy_state_layout(from);
+  jaffarCommon::deserializer::Contiguous d(state.data(), state.size());
+  to->deserializeState(d);
+}
+
+} // namespace quickerNES
@@ -0,0 +1,92 @@
+#pragma once
+
+// Deferred rendering of an emulator's frames on a separate thread
+
+#include "ppuLog.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace quickerNES
+{
+
+class Core;
+class Emu;
+
+// Renders the frames of a source emulator that runs headless (emulate_skip_frame). The source logs
+// the PPU-visible events of each frame, and end_frame() hands the log over to a worker thread that
+// replays it into an output emulator while the source emulates the next frame. The source still
+// runs the PPU timing, so sprite 0 hits and status flags stay exact. Frames come out identical to
+// direct rendering. Carts with CHR latches (MMC2/MMC4) are refused, as their bank switches happen
+// while drawing and are not tracked by a headless source.
+//
+// The logs of the last history_size frames are kept, along with a state of the source every
+// keyframe_interval frames, so that render_frame() can render any of them again later.
+class Deferred_Renderer
+{
+  public:
+  Deferred_Renderer() {}
+  ~Deferred_Renderer();
+
+  // Starts logging the frames of source and rendering them to output, which must have loaded the
+  // same cartridge. The output's pixel buffer and frame may only be accessed after wait().
+  const char *init(Emu *source, Emu *output, int history_size = 600, int keyframe_interval = 60);
+
+  // Restarts from the source's current state. Needed whenever the source state changes other than
+  // by emulating frames, e.g. after loading a state or resetting.
+  void sync();
+
+  // Hands the frame the source just completed over to the worker thread. The output emulator
+  // holds its image once wait() returns, until the next call to end_frame().
+  const char *end_frame();
+
+  // Waits until the worker thread is done with the last frame handed over
+  const char *wait();
+
+  // Number of frames handed over since init()
+  uint64_t frame_count() const { return frames; }
+
+  // Renders a frame handed over earlier (numbered from zero) into out, which must have loaded the
+  // same cartridge and must not be the output emulator.
+  const char *render_frame(uint64_t frame, Emu *out);
+
+  private:
+  struct record_t
+  {
+    uint64_t frame;
+    ppu_log_t log;
+    std::vector<uint8_t> keyframe; // source state at the start of the frame, if one was taken
+  };
+
+  // Record of a frame handed over earlier, numbered from the oldest one kept
+  record_t &history_at(size_t i) { return history[(history_first + i) % history.size()]; }
+
+  void run_worker();
+  void save_keyframe();
+  static void load_state(Emu *to, Core const &from, std::vector<uint8_t> const &state);
+
+  Emu *source = nullptr;
+  Emu *output = nullptr;
+  size_t history_size = 0;
+  uint64_t keyframe_interval = 0;
+  uint64_t frames = 0;
+  std::vector<record_t> history; // ring of history_size records, recycled oldest first
+  size_t history_first = 0;
+  size_t history_count = 0;
+  std::vector<uint8_t> next_keyframe;
+
+  // The source logs into one log while the worker replays the other
+  ppu_log_t logs[2];
+  int logging = 0;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cond;
+  ppu_log_t const *pending = nullptr; // log handed over to the worker, NULL once it is done
+  const char *worker_error = nullptr;
+  bool quit = false;
+};
+
+} // namespace quickerNES
@@ -0,0 +1,153 @@
+// Deferred sound synthesis of an emulator's frames on a separate thread
+
+#include "deferredSound.hpp"
+#include "core.hpp"
+#include "emu.hpp"
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <string.h>
+
+namespace quickerNES
+{
+
+Deferred_Sound::~Deferred_Sound()
+{
+  if (!source) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  worker.join();
+  source->set_apu_log(NULL);
+}
+
+const char *Deferred_Sound::init(Emu *source_, Emu *output_, int queue_size_)
+{
+  if (source) return "Deferred sound already initialized";
+  if (source_->cart() != output_->cart()) return "Output must use the same cartridge as the source";
+  if (queue_size_ < 1) return "Invalid queue size";
+
+  source = source_;
+  output = output_;
+  queue_size = queue_size_;
+
+  // one log more than can be queued, for the source to log into
+  logs.resize(queue_size + 1);
+  for (auto &log : logs)
+    free_logs.push_back(&log);
+  logging = free_logs.back();
+  free_logs.pop_back();
+
+  sync(); // no worker yet, so no error
+  worker = std::thread(&Deferred_Sound::run_worker, this);
+  return 0;
+}
+
+const char *Deferred_Sound::sync()
+{
+  const char *error = wait();
+
+  jaffarCommon::serializer::Contiguous size;
+  source->serializeState(size);
+  std::vector<uint8_t> state(size.getOutputSize());
+  jaffarCommon::serializer::Contiguous s(state.data(), state.size());
+  source->serializeState(s);
+
+  output->emu.copy_state_layout(source->emu);
+  jaffarCommon::deserializer::Contiguous d(state.data(), state.size());
+  output->deserializeState(d);
+  output->sound_buf->clear();
+
+  // The source has no use for sound of its own until it emulates a frame with sound again
+  source->sound_enabled = false;
+  source->enable_sound(false);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    samples.clear();
+    samples_read = 0;
+  }
+  logging->clear();
+  source->set_apu_log(logging);
+  return error;
+}
+
+const char *Deferred_Sound::end_frame()
+{
+  if (!logging->frame_length) return "No complete frame emulated since the last one queued";
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this] { return pending.size() < queue_size; });
+  pending.push_back(logging);
+  logging = free_logs.back();
+  free_logs.pop_back();
+  const char *error = worker_error;
+  worker_error = NULL;
+  lock.unlock();
+  cond.notify_all();
+
+  logging->clear();
+  source->set_apu_log(logging);
+  return error;
+}
+
+const char *Deferred_Sound::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this] { return pending.empty(); });
+  const char *error = worker_error;
+  worker_error = NULL;
+  return error;
+}
+
+long Deferred_Sound::samples_avail()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return samples.size() - samples_read;
+}
+
+long Deferred_Sound::read_samples(short *out, long max_samples)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  long avail = samples.size() - samples_read;
+  long count = avail < max_samples ? avail : max_samples;
+  memcpy(out, samples.data() + samples_read, count * sizeof(short));
+  samples_read += count;
+  return count;
+}
+
+void Deferred_Sound::run_worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    cond.wait(lock, [this] { return !pending.empty() || quit; });
+    if (quit) return;
+
+    // the log stays queued until its samples are added, so wait() covers it
+    apu_log_t *log = pending.front();
+    lock.unlock();
+    const char *error = output->replay_sound(*log);
+    frame_samples.resize(output->sound_buf->samples_avail());
+    long count = output->read_samples(frame_samples.data(), frame_samples.size());
+    lock.lock();
+
+    if (error) worker_error = error;
+
+    // Samples read already are dropped once they are at least half of the buffer, so moving the
+    // unread ones costs no more than reading those did
+    if (samples_read && samples_read * 2 >= samples.size())
+    {
+      samples.erase(samples.begin(), samples.begin() + samples_read);
+      samples_read = 0;
+    }
+    samples.insert(samples.end(), frame_samples.begin(), frame_samples.begin() + count);
+    pending.pop_front();
+    free_logs.push_back(log);
+    cond.notify_all();
+  }
+}
+
+} // namespace quickerNES
@@ -0,0 +1,77 @@
+#pragma once
+
+// Deferred sound synthesis of an emulator's frames on a separate thread
+
+#include "apuLog.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace quickerNES
+{
+
+class Emu;
+
+// Synthesizes the sound of a source emulator that runs headless (emulate_skip_frame). The source
+// logs the APU and sound chip events of each frame, and end_frame() queues the log for a worker
+// thread that replays it into an output emulator, while the source goes on with the next frames.
+// Samples come out identical to those the source would produce with sound enabled.
+//
+// Each frame's sound depends on the APU state the previous one left, so frames are synthesized
+// in order; the source only waits for the worker when queue_size frames are pending.
+class Deferred_Sound
+{
+  public:
+  Deferred_Sound() {}
+  ~Deferred_Sound();
+
+  // Starts logging the frames of source and synthesizing them with output, which must have loaded
+  // the same cartridge and have its sample rate set. The output emulator may only be accessed
+  // after wait().
+  const char *init(Emu *source, Emu *output, int queue_size = 4);
+
+  // Restarts from the source's current state, dropping samples not read yet. Needed whenever the
+  // source state changes other than by emulating frames, e.g. after loading a state or resetting.
+  // Returns the error the worker thread hit on the frames dropped, if any.
+  const char *sync();
+
+  // Queues the frame the source just completed for the worker thread
+  const char *end_frame();
+
+  // Waits until the worker thread is done with all frames queued
+  const char *wait();
+
+  // Number of samples synthesized and not read yet
+  long samples_avail();
+
+  // Reads up to max_samples synthesized samples into out. Returns the number read.
+  long read_samples(short *out, long max_samples);
+
+  private:
+  void run_worker();
+
+  Emu *source = nullptr;
+  Emu *output = nullptr;
+  size_t queue_size = 0;
+
+  // The source logs into one log while the worker replays the pending ones
+  std::vector<apu_log_t> logs;
+  std::deque<apu_log_t *> pending; // logs queued for the worker, oldest first
+  std::vector<apu_log_t *> free_logs;
+  apu_log_t *logging = nullptr;
+
+  std::vector<short> samples; // synthesized samples, the first samples_read of them read already
+  size_t samples_read = 0;
+  std::vector<short> frame_samples;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cond;
+  const char *worker_error = nullptr;
+  bool quit = false;
+};
+
+} // namespace quickerNES
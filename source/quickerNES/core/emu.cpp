@@ -37,13 +37,18 @@ Emu::Emu()
   default_sound_buf = NULL;
   sound_buf = &silent_buffer;
   sound_buf_changed_count = 0;
+  simd_sound = false;
   equalizer_ = nes_eq;
   channel_count_ = 0;
   sound_enabled = false;
   host_pixels = NULL;
+  host_pixels32 = NULL;
+  pixel_format = pixels_indexed8;
+  indexed_pixels = NULL;
   single_frame.pixels = 0;
   single_frame.top = 0;
   init_called = false;
+  skipping_frame = false;
   set_palette_range(0);
   memset(single_frame.palette, 0, sizeof single_frame.palette);
 
@@ -55,6 +60,7 @@ Emu::Emu()
 Emu::~Emu()
 {
   delete default_sound_buf;
+  delete[] indexed_pixels;
 }
 
 const char *Emu::init_()
@@ -87,7 +93,7 @@ const char *Emu::set_cart(Cart const *new_cart)
   error = emu.open(new_cart);
   if (error) return error;
 
-  channel_count_ = Apu::osc_count + emu.mapper->channel_count();
+  channel_count_ = Apu::osc_count + (emu.sound_chip ? emu.sound_chip->channel_count() : 0);
   error = sound_buf->set_channel_count(channel_count());
   if (error) return error;
   set_equalizer(equalizer_);
@@ -111,10 +117,90 @@ void Emu::set_palette_range(int begin, int end)
   host_palette_size = end - emu.ppu.palette_begin;
 }
 
+const char *Emu::set_pixels(void *p, long n, pixel_format_t format)
+{
+  pixels_base_ptr = p;
+  emu.ppu.set_observation(NULL, 0, NULL);
+  if (format == pixels_indexed8)
+  {
+    host_pixels = (char *)p + n;
+    emu.ppu.host_row_bytes = n;
+    host_pixels32 = NULL;
+    emu.ppu.color_lut = NULL;
+    pixel_format = format;
+    return 0;
+  }
+
+  const char *error = use_indexed_pixels();
+  if (error) return error;
+  host_pixels32 = (uint32_t *)p;
+  emu.ppu.host_row_bytes32 = n;
+
+  // colors are only converted when the output format changes; captured palettes are then
+  // resolved through this table as they are captured
+  if (format != pixel_format)
+  {
+    int const red = (format == pixels_rgba32) ? 0 : 2;
+    for (int i = 0; i < color_table_size; i++)
+    {
+      uint8_t color[4];
+      color[red] = nes_colors[i].red;
+      color[1] = nes_colors[i].green;
+      color[2 - red] = nes_colors[i].blue;
+      color[3] = 0xFF;
+      memcpy(&color_lut[i], color, sizeof color);
+    }
+  }
+  emu.ppu.color_lut = color_lut;
+  pixel_format = format;
+  return 0;
+}
+
+const char *Emu::set_observation(uint8_t *pixels, long row_bytes, observation_t const &obs, observation_format_t format)
+{
+  if (obs.box_filter && format != observation_grayscale) return "Observation box filter needs grayscale output";
+  const char *error = emu.ppu.set_observation(pixels, row_bytes, &obs);
+  if (!error) error = use_indexed_pixels();
+  if (error)
+  {
+    emu.ppu.set_observation(NULL, 0, NULL);
+    return error;
+  }
+
+  pixels_base_ptr = pixels;
+  host_pixels32 = NULL;
+
+  // ITU-R BT.601 luma
+  for (int i = 0; i < color_table_size; i++)
+  {
+    if (format == observation_grayscale)
+      color_lut[i] = (nes_colors[i].red * 299 + nes_colors[i].green * 587 + nes_colors[i].blue * 114 + 500) / 1000;
+    else
+      color_lut[i] = i & 0x3F;
+  }
+  emu.ppu.color_lut = color_lut;
+  pixel_format = pixels_indexed8; // color_lut no longer holds 32-bit colors
+  return 0;
+}
+
+const char *Emu::use_indexed_pixels()
+{
+  // the emulator draws into a buffer of its own, which is converted to the output
+  if (!indexed_pixels)
+  {
+    indexed_pixels = new (std::nothrow) uint8_t[buffer_width * buffer_height_];
+    if (!indexed_pixels) return "Out of memory";
+  }
+  host_pixels = (char *)indexed_pixels + buffer_width;
+  emu.ppu.host_row_bytes = buffer_width;
+  return 0;
+}
+
 const char *Emu::emulate_skip_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arkanoid_latch, uint8_t arkanoid_fire)
 {
   char *old_host_pixels = host_pixels;
   host_pixels = NULL;
+  skipping_frame = true;
   emu.emulate_frame(joypad1, joypad2, arkanoid_latch, arkanoid_fire);
   host_pixels = old_host_pixels;
   return 0;
@@ -122,7 +208,17 @@ const char *Emu::emulate_skip_frame(uint32_t joypad1, uint32_t joypad2, uint32_t
 
 const char *Emu::emulate_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arkanoid_latch, uint8_t arkanoid_fire)
 {
+  // A frame stopped by a watch continues with the new inputs
+  if (emu.frame_in_progress())
+  {
+    nes_time_t frame_len = emu.emulate_frame(joypad1, joypad2, arkanoid_latch, arkanoid_fire);
+    if (!skipping_frame && frame_) end_frame_(frame_len);
+    return 0;
+  }
+
+  skipping_frame = false;
   emu.ppu.host_pixels = NULL;
+  emu.ppu.host_pixels32 = NULL;
 
   unsigned changed_count = sound_buf->channels_changed_count();
   bool new_enabled = (frame_ != NULL);
@@ -137,31 +233,13 @@ const char *Emu::emulate_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arka
   frame_t *f = frame_;
   if (f)
   {
-    emu.ppu.max_palette_size = host_palette_size;
-    emu.ppu.host_palette = f->palette + emu.ppu.palette_begin;
-    // add black and white for emulator to use (unless emulator uses entire
-    // palette for frame)
-    f->palette[252] = 0x0F;
-    f->palette[254] = 0x30;
-    f->palette[255] = 0x0F;
-    if (host_pixels)
-      emu.ppu.host_pixels = (uint8_t *)host_pixels +
-                            emu.ppu.host_row_bytes * f->top;
+    begin_frame_video_();
 
     if (sound_buf->samples_avail())
       clear_sound_buf();
 
     nes_time_t frame_len = emu.emulate_frame(joypad1, joypad2, arkanoid_latch, arkanoid_fire);
-    sound_buf->end_frame(frame_len, false);
-
-    f = frame_;
-    f->sample_count = sound_buf->samples_avail();
-    f->chan_count = sound_buf->samples_per_frame();
-    f->palette_begin = emu.ppu.palette_begin;
-    f->palette_size = emu.ppu.palette_size;
-    f->burst_phase = emu.ppu.burst_phase;
-    f->pitch = emu.ppu.host_row_bytes;
-    f->pixels = emu.ppu.host_pixels + f->left;
+    end_frame_(frame_len);
   }
   else
   {
@@ -172,6 +250,97 @@ const char *Emu::emulate_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arka
   return 0;
 }
 
+const char *Emu::resume_frame()
+{
+  nes_time_t frame_len = emu.resume_frame();
+  if (!skipping_frame && frame_) end_frame_(frame_len);
+  return 0;
+}
+
+const char *Emu::replay_frame(ppu_log_t const &log, bool draw)
+{
+  if (emu.frame_in_progress()) return "Frame in progress";
+  if (!log.frame_length) return "Logged frame is incomplete";
+
+  emu.ppu.host_pixels = NULL;
+  emu.ppu.host_pixels32 = NULL;
+
+  frame_t *f = frame_;
+  if (f && draw)
+  {
+    begin_frame_video_();
+    emu.replay_frame(log);
+    f->sample_count = 0;
+    f->chan_count = 0;
+    end_frame_video_();
+  }
+  else
+  {
+    emu.ppu.max_palette_size = 0;
+    emu.replay_frame(log);
+  }
+
+  return 0;
+}
+
+const char *Emu::replay_sound(apu_log_t const &log)
+{
+  if (emu.frame_in_progress()) return "Frame in progress";
+  if (!log.frame_length) return "Logged frame is incomplete";
+
+  unsigned changed_count = sound_buf->channels_changed_count();
+  if (sound_buf_changed_count != changed_count || !sound_enabled)
+  {
+    sound_buf_changed_count = changed_count;
+    sound_enabled = true;
+    enable_sound(true);
+  }
+
+  nes_time_t frame_len = emu.replay_sound(log);
+  sound_buf->end_frame(frame_len, false);
+  return 0;
+}
+
+void Emu::begin_frame_video_()
+{
+  frame_t *f = frame_;
+  emu.ppu.max_palette_size = host_palette_size;
+  emu.ppu.host_palette = f->palette + emu.ppu.palette_begin;
+  // add black and white for emulator to use (unless emulator uses entire
+  // palette for frame)
+  f->palette[252] = 0x0F;
+  f->palette[254] = 0x30;
+  f->palette[255] = 0x0F;
+  if (host_pixels)
+    emu.ppu.host_pixels = (uint8_t *)host_pixels +
+                          emu.ppu.host_row_bytes * f->top;
+  if (host_pixels && host_pixels32)
+    emu.ppu.host_pixels32 = host_pixels32;
+}
+
+void Emu::end_frame_(nes_time_t frame_len)
+{
+  // Frame stopped by a watch
+  if (frame_len == 0) return;
+
+  sound_buf->end_frame(frame_len, false);
+
+  frame_t *f = frame_;
+  f->sample_count = sound_buf->samples_avail();
+  f->chan_count = sound_buf->samples_per_frame();
+  end_frame_video_();
+}
+
+void Emu::end_frame_video_()
+{
+  frame_t *f = frame_;
+  f->palette_begin = emu.ppu.palette_begin;
+  f->palette_size = emu.ppu.palette_size;
+  f->burst_phase = emu.ppu.burst_phase;
+  f->pitch = emu.ppu.host_row_bytes;
+  f->pixels = emu.ppu.host_pixels + f->left;
+}
+
 // Extras
 
 const char *Emu::load_ines(const uint8_t *buffer, const uint32_t length)
@@ -231,6 +400,7 @@ const char *Emu::set_sample_rate(long rate, Multi_Buffer *new_buf)
   if (error) return error;
   sound_buf = new_buf;
   sound_buf_changed_count = 0;
+  sound_buf->set_simd(simd_sound);
   if (new_buf != default_sound_buf)
   {
     delete default_sound_buf;
@@ -240,6 +410,13 @@ const char *Emu::set_sample_rate(long rate, Multi_Buffer *new_buf)
   return 0;
 }
 
+bool Emu::set_simd_sound(bool enabled)
+{
+  simd_sound = enabled;
+  sound_buf->set_simd(enabled);
+  return Blip_Buffer::simd_available();
+}
+
 const char *Emu::set_sample_rate(long rate)
 {
   if (!default_sound_buf)
@@ -258,7 +435,7 @@ void Emu::set_equalizer(equalizer_t const &eq)
   {
     blip_eq_t blip_eq(eq.treble, 0, sound_buf->sample_rate());
     emu.impl->apu.treble_eq(blip_eq);
-    emu.mapper->set_treble(blip_eq);
+    if (emu.sound_chip) emu.sound_chip->treble_eq(blip_eq);
     sound_buf->bass_freq(equalizer_.bass);
   }
 }
@@ -274,14 +451,14 @@ void Emu::enable_sound(bool enabled)
       if (mapper_index < 0)
         emu.impl->apu.osc_output(i, buf);
       else
-        emu.mapper->set_channel_buf(mapper_index, buf);
+        emu.sound_chip->osc_output(mapper_index, buf);
     }
   }
   else
   {
     emu.impl->apu.output(NULL);
     for (int i = channel_count() - Apu::osc_count; i-- > 0;)
-      emu.mapper->set_channel_buf(i, NULL);
+      emu.sound_chip->osc_output(i, NULL);
   }
 }
 
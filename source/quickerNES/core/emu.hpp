@@ -34,9 +34,34 @@ class Emu
   uint16_t buffer_height() const { return buffer_height_; }
   static const uint8_t bits_per_pixel = 8;
 
+  // Formats of the graphics buffer. Indexed pixels are host palette entries, to be looked up
+  // in frame().palette. The 32-bit formats hold final colors from nes_colors, named by their byte
+  // order in memory, with alpha set to 0xFF.
+  enum pixel_format_t
+  {
+    pixels_indexed8 = 0,
+    pixels_rgba32,
+    pixels_bgra32
+  };
+
   // Set graphics buffer to render pixels to. Pixels points to top-left pixel and
   // row_bytes is the number of bytes to get to the next line (positive or negative).
-  void set_pixels(void *pixels, long row_bytes);
+  // An indexed buffer must be buffer_width x buffer_height(). A 32-bit buffer only holds
+  // the image (image_width x image_height); the emulator then draws into a buffer of its
+  // own and converts each band of scanlines as soon as it is complete.
+  const char *set_pixels(void *pixels, long row_bytes, pixel_format_t format = pixels_indexed8);
+
+  // Observation output for learning agents: instead of the image, renders a crop of it scaled
+  // down to out_width x out_height, one byte per pixel, as luma or NES palette index (0-63,
+  // without emphasis). Only the scanlines it samples are drawn. The box filter needs grayscale.
+  // Replaces any buffer given to set_pixels(), and is disabled by calling it again.
+  typedef Ppu::observation_t observation_t;
+  enum observation_format_t
+  {
+    observation_grayscale = 0,
+    observation_palette
+  };
+  const char *set_observation(uint8_t *pixels, long row_bytes, observation_t const &, observation_format_t format);
 
   // Size of image generated in graphics buffer
   static const uint16_t image_width = 256;
@@ -45,6 +70,10 @@ class Emu
   const uint8_t *getHostPixels() const { return emu.ppu.host_pixels; }
 
   int get_joypad_read_count() const { return emu.joypad_read_count; }
+#ifdef _QUICKERNES_ENABLE_STATS
+  // Work done while emulating the current (or last completed) frame
+  const frame_stats_t &get_frame_stats() const { return emu.stats; }
+#endif
   void set_tracecb(void (*cb)(unsigned int *dest)) { emu.set_tracecb(cb); }
 
   // Save emulator state variants
@@ -55,6 +84,9 @@ class Emu
   void enableStateBlock(const std::string &block) { emu.enableStateBlock(block); };
   void disableStateBlock(const std::string &block) { emu.disableStateBlock(block); };
   void setControllerType(Core::controllerType_t type) { emu.setControllerType(type); }
+#ifdef _QUICKERNES_ENABLE_INPUT_CALLBACK
+  void set_input_callback(void (*cb)(void *context), void *context) { emu.set_input_callback(cb, context); }
+#endif
 
   void useFlatCodeMap()
   {
@@ -77,6 +109,33 @@ class Emu
   // Afterwards, audio is available for output using the accessors below.
   virtual const char *emulate_skip_frame(uint32_t joypad1, uint32_t joypad2, uint32_t arkanoid_latch, uint8_t arkanoid_fire);
 
+  // Run-until-condition support. While watches are set, emulate_frame() and emulate_skip_frame()
+  // may stop mid-frame, in which case frame_in_progress() is true, triggered_watch() tells which
+  // watch stopped it, and resume_frame() continues from the exact stop point. Watches return
+  // their index, or -1 if the watch table is full.
+  int add_pc_watch(nes_addr_t addr) { return emu.add_pc_watch(addr); }
+  int add_ram_write_watch(nes_addr_t addr, int value = -1) { return emu.add_ram_write_watch(addr, value); }
+  int add_scanline_watch(int scanline) { return emu.add_scanline_watch(scanline); }
+  int add_cycle_watch(nes_time_t cycles) { return emu.add_cycle_watch(cycles); }
+  void clear_watches() { emu.clear_watches(); }
+  int triggered_watch() const { return emu.triggered_watch(); }
+  bool frame_in_progress() const { return emu.frame_in_progress(); }
+  const char *resume_frame();
+
+  // Deferred rendering. While set, every frame emulated logs its PPU-visible events into log
+  // (see ppu_log_t). replay_frame() renders such a frame, or only advances the PPU through it if
+  // draw is false, without emulating anything else. This emulator must have loaded the same
+  // cartridge and hold the logging emulator's state from the start of that frame.
+  void set_ppu_log(ppu_log_t *log) { emu.ppu_log = log; }
+  const char *replay_frame(ppu_log_t const &log, bool draw = true);
+
+  // Deferred sound. While set, every frame emulated logs its APU and sound chip events into log
+  // (see apu_log_t). replay_sound() synthesizes such a frame's sound without emulating anything
+  // else; its samples add to the ones not read yet. This emulator must have loaded the same
+  // cartridge and hold the logging emulator's state from the start of that frame.
+  void set_apu_log(apu_log_t *log) { emu.apu_log = log; }
+  const char *replay_sound(apu_log_t const &log);
+
   // Maximum size of palette that can be generated
   static const uint16_t max_palette_size = 256;
 
@@ -85,7 +144,7 @@ class Emu
   {
     static const uint8_t left = 8;
 
-    int burst_phase; // NTSC burst phase for frame (0, 1, or 2)
+    int burst_phase; // NTSC burst phase for frame (0, 1, or 2), used by Ntsc_Filter
 
     int sample_count; // number of samples (always a multiple of chan_count)
     int chan_count;   // 1: mono, 2: stereo
@@ -130,6 +189,11 @@ class Emu
   // mono buffer, i.e. Buffer, Effects_Buffer, etc..
   const char *set_sample_rate(long rate, Multi_Buffer *);
 
+  // Synthesize sound with vectorized loops when the host CPU supports them (off by default), in
+  // the current sound buffer and any set later. The samples are the same either way. Returns
+  // false if no vectorized loops are available.
+  bool set_simd_sound(bool enabled);
+
   // Adjust effective frame rate by changing how many samples are generated each frame.
   // Allows fine tuning of frame rate to improve synchronization.
   void set_frame_rate(double rate);
@@ -177,8 +241,8 @@ class Emu
     color_table_size = 8 * 64
   };
 
-  // NES color lookup table based on standard NTSC TV decoder. Use nes_ntsc.h to
-  // generate a palette with custom parameters.
+  // NES color lookup table based on standard NTSC TV decoder. Ntsc_Filter (ntscFilter.hpp)
+  // keeps these colors and adds the composite artifacts, with custom hue and saturation.
   struct rgb_t
   {
     unsigned char red, green, blue;
@@ -194,6 +258,14 @@ class Emu
   };
   void set_sprite_mode(sprite_mode_t n) { emu.ppu.sprite_limit = n; }
 
+  // Use SSE2/AVX2 background rendering when the host CPU supports it (default). The output is the
+  // same either way. Returns false if no vectorised renderer is available.
+  bool set_simd_rendering(bool enabled)
+  {
+    emu.ppu.set_simd_rendering(enabled);
+    return emu.ppu.simd_rendering() == enabled;
+  }
+
   // Set range of host palette entries to use in graphics buffer; default uses
   // all of them. Begin will be rounded up to next multiple of palette_alignment.
   // Use frame().palette_begin to find the adjusted beginning entry used.
@@ -273,6 +345,9 @@ class Emu
   void set_timestamp(long t) {}
 
   private:
+  friend class Deferred_Renderer;
+  friend class Deferred_Sound;
+
   // noncopyable
   Emu(const Emu &);
   Emu &operator=(const Emu &);
@@ -281,6 +356,7 @@ class Emu
   Multi_Buffer *default_sound_buf;
   Multi_Buffer *sound_buf;
   unsigned sound_buf_changed_count;
+  bool simd_sound;
   Silent_Buffer silent_buffer;
   equalizer_t equalizer_;
   int channel_count_;
@@ -289,8 +365,18 @@ class Emu
   void clear_sound_buf();
   void fade_samples(blip_sample_t *, int size, int step);
 
+  void end_frame_(nes_time_t frame_len);
+  void begin_frame_video_();
+  void end_frame_video_();
+  bool skipping_frame;
+
   void *pixels_base_ptr;
   char *host_pixels;
+  uint32_t *host_pixels32;
+  pixel_format_t pixel_format;
+  uint8_t *indexed_pixels; // drawing buffer for 32-bit and observation output
+  const char *use_indexed_pixels();
+  uint32_t color_lut[color_table_size];
   int host_palette_size;
   frame_t single_frame;
   Cart private_cart;
@@ -313,13 +399,6 @@ class Emu
   }
 };
 
-inline void Emu::set_pixels(void *p, long n)
-{
-  pixels_base_ptr = p;
-  host_pixels = (char *)p + n;
-  emu.ppu.host_row_bytes = n;
-}
-
 inline uint8_t *Emu::chr_mem() const
 {
   return cart()->chr_size() ? (uint8_t *)cart()->chr() : emu.ppu.impl->chr_ram;
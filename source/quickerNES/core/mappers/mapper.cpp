@@ -5,6 +5,7 @@
 #include "../core.hpp"
 #include <string.h>
 #include <new>
+#include <type_traits>
 
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -83,8 +84,7 @@ namespace quickerNES
 Mapper::Mapper()
 {
   emu_ = NULL;
-  static char c;
-  state = &c; // TODO: state must not be null?
+  state = &null_state; // mappers without registered state still need a valid pointer
   state_size = 0;
 }
 
@@ -168,18 +168,12 @@ void Mapper::end_frame(nes_time_t) {}
 
 bool Mapper::ppu_enabled() const { return emu().ppu.w2001 & 0x08; }
 
-// Sound
-
-int Mapper::channel_count() const { return 0; }
-
-void Mapper::set_channel_buf(int, Blip_Buffer *) {}
-
-void Mapper::set_treble(blip_eq_t const &) {}
-
 // Memory mapping
 
 void Mapper::set_prg_bank(nes_addr_t addr, bank_size_t bs, int bank)
 {
+  NES_STAT(emu_->stats.bank_requests++);
+
   int bank_size = 1 << bs;
 
   int bank_count = cart_->prg_size() >> bs;
@@ -189,30 +183,64 @@ void Mapper::set_prg_bank(nes_addr_t addr, bank_size_t bs, int bank)
   if (bank >= bank_count)
     bank %= bank_count;
 
-  emu().map_code(addr, bank_size, cart_->prg() + (bank << bs));
+  // PRG never changes, so a bank already mapped (and its flat code map copy) can stay as it is
+  uint8_t const *data = cart_->prg() + (bank << bs);
+  if (!emu().code_mapped(addr, bank_size, data))
+  {
+    NES_STAT(emu_->stats.bank_switches++);
+    emu().map_code(addr, bank_size, data);
+  }
 
   if (unsigned(addr - 0x6000) < 0x2000)
     emu().enable_prg_6000();
 }
 
+// A setting that leaves the mapping as it is neither needs the PPU caught up nor goes in the log.
+// Mappers can thus set all their banks after every register write, and only pay for those that
+// changed.
+
 void Mapper::set_chr_bank(nes_addr_t addr, bank_size_t bs, int bank)
 {
+  NES_STAT(emu_->stats.bank_requests++);
+  if (emu().ppu.chr_bank_mapped(addr, 1 << bs, bank << bs)) return;
+  NES_STAT(emu_->stats.bank_switches++);
+  if (emu().ppu_log) emu().ppu_log->add(ppu_log_t::chr_bank, emu().clock(), addr, bs, bank << bs);
   emu().ppu.render_until(emu().clock());
   emu().ppu.set_chr_bank(addr, 1 << bs, bank << bs);
 }
 
 void Mapper::set_chr_bank_ex(nes_addr_t addr, bank_size_t bs, int bank)
 {
+  NES_STAT(emu_->stats.bank_requests++);
+  if (emu().ppu.chr_bank_ex_mapped(addr, 1 << bs, bank << bs)) return;
+  NES_STAT(emu_->stats.bank_switches++);
+  if (emu().ppu_log) emu().ppu_log->add(ppu_log_t::chr_bank_ex, emu().clock(), addr, bs, bank << bs);
   emu().ppu.render_until(emu().clock());
   emu().ppu.set_chr_bank_ex(addr, 1 << bs, bank << bs);
 }
 
 void Mapper::mirror_manual(int page0, int page1, int page2, int page3)
 {
+  NES_STAT(emu_->stats.bank_requests++);
+  if (emu().ppu.nt_banks_mapped(page0, page1, page2, page3)) return;
+  NES_STAT(emu_->stats.bank_switches++);
+  if (emu().ppu_log) emu().ppu_log->add(ppu_log_t::nt_banks, emu().clock(), 0, 0, page0 | page1 << 8 | page2 << 16 | page3 << 24);
   emu().ppu.render_bg_until(emu().clock());
   emu().ppu.set_nt_banks(page0, page1, page2, page3);
 }
 
+void Mapper::sound_write(nes_time_t time, nes_addr_t addr, int data)
+{
+  if (emu().apu_log) emu().apu_log->add(apu_log_t::sound_write, time, addr, data);
+  emu().sound_chip->write_register(time, addr, data);
+}
+
+int Mapper::sound_read(nes_time_t time, nes_addr_t addr)
+{
+  if (emu().apu_log) emu().apu_log->add(apu_log_t::sound_read, time, addr, 0);
+  return emu().sound_chip->read_register(time, addr);
+}
+
 void Mapper::intercept_reads(nes_addr_t addr, unsigned size)
 {
   emu().add_mapper_intercept(addr, size, true, false);
@@ -228,70 +256,96 @@ void Mapper::enable_sram(bool enabled, bool read_only)
   emu_->enable_sram(enabled, read_only);
 }
 
-Mapper *Mapper::getMapperFromCode(const int mapperCode)
+// Registry
+
+template <class T>
+static Mapper *create_mapper() { return new (std::nothrow) T(); }
+
+// A member a mapper doesn't override still has the type of the Mapper one
+#define MAPPER_OVERRIDES(T, member) (!std::is_same<decltype(&T::member), decltype(&Mapper::member)>::value)
+
+template <class T>
+static constexpr unsigned mapper_caps()
 {
-  Mapper *mapper = nullptr;
-
-  // Now checking if the detected mapper code is supported
-  if (mapperCode == 0) mapper = new (std::nothrow) Mapper000();
-  if (mapperCode == 1) mapper = new (std::nothrow) Mapper001();
-  if (mapperCode == 2) mapper = new (std::nothrow) Mapper002();
-  if (mapperCode == 3) mapper = new (std::nothrow) Mapper003();
-  if (mapperCode == 4) mapper = new (std::nothrow) Mapper004();
+  return (MAPPER_OVERRIDES(T, next_irq) || MAPPER_OVERRIDES(T, run_until) ? mapper_irq : 0) |
+         (MAPPER_OVERRIDES(T, end_frame) ? mapper_end_frame : 0) |
+         (MAPPER_OVERRIDES(T, a12_clocked) ? mapper_a12 : 0);
+}
+
+#define MAPPER_ENTRY(code, T, name) {code, name, mapper_caps<T>(), create_mapper<T>}
+
+static mapper_info_t const mapper_registry[] = {
+  MAPPER_ENTRY(0, Mapper000, "NROM"),
+  MAPPER_ENTRY(1, Mapper001, "MMC1"),
+  MAPPER_ENTRY(2, Mapper002, "UxROM"),
+  MAPPER_ENTRY(3, Mapper003, "CNROM"),
+  MAPPER_ENTRY(4, Mapper004, "MMC3"),
   // https://github.com/TASEmulators/BizHawk/commit/b1f4a77251fbb1a9553958766891617756a75293
   // MMC5 support is poor in QuickNES, so we do not use it
-  //if (mapperCode == 5) mapper = new (std::nothrow) Mapper005();
-  if (mapperCode == 7) mapper = new (std::nothrow) Mapper007();
-  if (mapperCode == 9) mapper = new (std::nothrow) Mapper009();
-  if (mapperCode == 10) mapper = new (std::nothrow) Mapper010();
-  if (mapperCode == 11) mapper = new (std::nothrow) Mapper011();
-  if (mapperCode == 15) mapper = new (std::nothrow) Mapper015();
-  if (mapperCode == 19) mapper = new (std::nothrow) Mapper019();
-  if (mapperCode == 21) mapper = new (std::nothrow) Mapper021();
-  if (mapperCode == 22) mapper = new (std::nothrow) Mapper022();
-  if (mapperCode == 23) mapper = new (std::nothrow) Mapper023();
-  if (mapperCode == 24) mapper = new (std::nothrow) Mapper024();
-  if (mapperCode == 25) mapper = new (std::nothrow) Mapper025();
-  if (mapperCode == 26) mapper = new (std::nothrow) Mapper026();
-  if (mapperCode == 30) mapper = new (std::nothrow) Mapper030();
-  if (mapperCode == 32) mapper = new (std::nothrow) Mapper032();
-  if (mapperCode == 33) mapper = new (std::nothrow) Mapper033();
-  if (mapperCode == 34) mapper = new (std::nothrow) Mapper034();
-  if (mapperCode == 60) mapper = new (std::nothrow) Mapper060();
-  if (mapperCode == 66) mapper = new (std::nothrow) Mapper066();
-  if (mapperCode == 69) mapper = new (std::nothrow) Mapper069();
-  if (mapperCode == 70) mapper = new (std::nothrow) Mapper070();
-  if (mapperCode == 71) mapper = new (std::nothrow) Mapper071();
-  if (mapperCode == 73) mapper = new (std::nothrow) Mapper073();
-  if (mapperCode == 75) mapper = new (std::nothrow) Mapper075();
-  if (mapperCode == 78) mapper = new (std::nothrow) Mapper078();
-  if (mapperCode == 79) mapper = new (std::nothrow) Mapper079();
-  if (mapperCode == 85) mapper = new (std::nothrow) Mapper085();
-  if (mapperCode == 86) mapper = new (std::nothrow) Mapper086();
-  if (mapperCode == 87) mapper = new (std::nothrow) Mapper087();
-  if (mapperCode == 88) mapper = new (std::nothrow) Mapper088();
-  if (mapperCode == 89) mapper = new (std::nothrow) Mapper089();
-  if (mapperCode == 93) mapper = new (std::nothrow) Mapper093();
-  if (mapperCode == 94) mapper = new (std::nothrow) Mapper094();
-  if (mapperCode == 97) mapper = new (std::nothrow) Mapper097();
-  if (mapperCode == 113) mapper = new (std::nothrow) Mapper113();
-  if (mapperCode == 140) mapper = new (std::nothrow) Mapper140();
-  if (mapperCode == 152) mapper = new (std::nothrow) Mapper152();
-  if (mapperCode == 154) mapper = new (std::nothrow) Mapper154();
-  if (mapperCode == 156) mapper = new (std::nothrow) Mapper156();
-  if (mapperCode == 180) mapper = new (std::nothrow) Mapper180();
-  if (mapperCode == 184) mapper = new (std::nothrow) Mapper184();
-  if (mapperCode == 190) mapper = new (std::nothrow) Mapper190();
-  if (mapperCode == 193) mapper = new (std::nothrow) Mapper193();
-  if (mapperCode == 206) mapper = new (std::nothrow) Mapper206();
-  if (mapperCode == 207) mapper = new (std::nothrow) Mapper207();
-  if (mapperCode == 232) mapper = new (std::nothrow) Mapper232();
-  if (mapperCode == 240) mapper = new (std::nothrow) Mapper240();
-  if (mapperCode == 241) mapper = new (std::nothrow) Mapper241();
-  if (mapperCode == 244) mapper = new (std::nothrow) Mapper244();
-  if (mapperCode == 246) mapper = new (std::nothrow) Mapper246();
-
-  return mapper;
+  // MAPPER_ENTRY(5, Mapper005, "MMC5"),
+  MAPPER_ENTRY(7, Mapper007, "AxROM"),
+  MAPPER_ENTRY(9, Mapper009, "MMC2"),
+  MAPPER_ENTRY(10, Mapper010, "MMC4"),
+  MAPPER_ENTRY(11, Mapper011, "Color Dreams"),
+  MAPPER_ENTRY(15, Mapper015, "K-1029"),
+  MAPPER_ENTRY(19, Mapper019, "Namco 163"),
+  MAPPER_ENTRY(21, Mapper021, "VRC4a/VRC4c"),
+  MAPPER_ENTRY(22, Mapper022, "VRC2a"),
+  MAPPER_ENTRY(23, Mapper023, "VRC2b/VRC4e"),
+  MAPPER_ENTRY(24, Mapper024, "VRC6a"),
+  MAPPER_ENTRY(25, Mapper025, "VRC4b/VRC4d"),
+  MAPPER_ENTRY(26, Mapper026, "VRC6b"),
+  MAPPER_ENTRY(30, Mapper030, "UNROM 512"),
+  MAPPER_ENTRY(32, Mapper032, "Irem G-101"),
+  MAPPER_ENTRY(33, Mapper033, "Taito TC0190"),
+  MAPPER_ENTRY(34, Mapper034, "BNROM/NINA-001"),
+  MAPPER_ENTRY(60, Mapper060, "NROM-128 4-in-1"),
+  MAPPER_ENTRY(66, Mapper066, "GxROM"),
+  MAPPER_ENTRY(69, Mapper069, "Sunsoft FME-7"),
+  MAPPER_ENTRY(70, Mapper070, "Bandai 74161/32"),
+  MAPPER_ENTRY(71, Mapper071, "Camerica"),
+  MAPPER_ENTRY(73, Mapper073, "VRC3"),
+  MAPPER_ENTRY(75, Mapper075, "VRC1"),
+  MAPPER_ENTRY(78, Mapper078, "Irem 74HC161/32"),
+  MAPPER_ENTRY(79, Mapper079, "AVE NINA-03/06"),
+  MAPPER_ENTRY(85, Mapper085, "VRC7"),
+  MAPPER_ENTRY(86, Mapper086, "Jaleco JF-13"),
+  MAPPER_ENTRY(87, Mapper087, "Jaleco JF-05"),
+  MAPPER_ENTRY(88, Mapper088, "Namco 118 (3443)"),
+  MAPPER_ENTRY(89, Mapper089, "Sunsoft-2b"),
+  MAPPER_ENTRY(93, Mapper093, "Sunsoft-2a"),
+  MAPPER_ENTRY(94, Mapper094, "UN1ROM"),
+  MAPPER_ENTRY(97, Mapper097, "Irem TAM-S1"),
+  MAPPER_ENTRY(113, Mapper113, "HES NTD-8"),
+  MAPPER_ENTRY(140, Mapper140, "Jaleco JF-11"),
+  MAPPER_ENTRY(152, Mapper152, "Bandai 74161/32 (1-screen)"),
+  MAPPER_ENTRY(154, Mapper154, "Namco 118 (3453)"),
+  MAPPER_ENTRY(156, Mapper156, "DIS23C01 DAOU"),
+  MAPPER_ENTRY(180, Mapper180, "UxROM (inverted)"),
+  MAPPER_ENTRY(184, Mapper184, "Sunsoft-1"),
+  MAPPER_ENTRY(190, Mapper190, "Magic Kid GooGoo"),
+  MAPPER_ENTRY(193, Mapper193, "NTDEC TC-112"),
+  MAPPER_ENTRY(206, Mapper206, "Namco 118"),
+  MAPPER_ENTRY(207, Mapper207, "Taito X1-005"),
+  MAPPER_ENTRY(232, Mapper232, "Camerica BF9096"),
+  MAPPER_ENTRY(240, Mapper240, "C&E 240"),
+  MAPPER_ENTRY(241, Mapper241, "BxROM (241)"),
+  MAPPER_ENTRY(244, Mapper244, "C&E 244"),
+  MAPPER_ENTRY(246, Mapper246, "G0151-1"),
+};
+
+const mapper_info_t *Mapper::getMapperInfo(const int mapperCode)
+{
+  for (auto const &info : mapper_registry)
+    if (info.code == mapperCode)
+      return &info;
+  return NULL;
+}
+
+Mapper *Mapper::getMapperFromCode(const int mapperCode)
+{
+  const mapper_info_t *info = getMapperInfo(mapperCode);
+  return info ? info->create() : nullptr;
 }
 
 } // namespace quickerNES
\ No newline at end of file
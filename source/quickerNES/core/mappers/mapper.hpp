@@ -10,9 +10,8 @@
 namespace quickerNES
 {
 
-class Blip_Buffer;
-class blip_eq_t;
 class Core;
+class Expansion_Apu;
 
 // Increase this (and let me know) if your mapper requires more state. This only
 // sets the size of the in-memory buffer; it doesn't affect the file format at all.
@@ -30,6 +29,26 @@ struct mapper_state_t
   int read(void *p, unsigned long s) const;
 };
 
+class Mapper;
+
+// What a mapper does beyond mapping memory, from the parts of the Mapper interface it overrides.
+// The core leaves out what a cartridge's mapper doesn't use.
+enum mapper_caps_t
+{
+  mapper_irq = 0x01,       // next_irq() and run_until()
+  mapper_end_frame = 0x02, // end_frame()
+  mapper_a12 = 0x04        // a12_clocked()
+};
+
+// Entry of the table of supported mappers
+struct mapper_info_t
+{
+  int code;           // iNES mapper number
+  const char *name;   // board or chip
+  unsigned caps;      // mapper_caps_t flags
+  Mapper *(*create)(); // returns NULL if out of memory
+};
+
 class Mapper
 {
   public:
@@ -74,14 +93,10 @@ class Mapper
 
   // Sound
 
-  // Number of sound channels
-  virtual int channel_count() const;
-
-  // Set sound buffer for channel to output to, or NULL to silence channel.
-  virtual void set_channel_buf(int index, Blip_Buffer *);
-
-  // Set treble equalization
-  virtual void set_treble(blip_eq_t const &);
+  // Sound chip on the cartridge, or NULL if there's none. The core drives its output, treble and
+  // frames; the mapper routes every CPU access to its registers through sound_write() and
+  // sound_read(), so that Core::replay_sound() can run the chip from a log of them alone.
+  virtual Expansion_Apu *sound_chip();
 
   // Misc
 
@@ -91,6 +106,7 @@ class Mapper
 
   void *state;
   unsigned state_size;
+  char null_state;
 
   protected:
   // Services provided for derived mapper classes
@@ -165,6 +181,10 @@ class Mapper
   // the same as byte in PRG at same address and writes debug message if it doesn't.
   int handle_bus_conflict(nes_addr_t addr, int data);
 
+  // Access the sound chip's registers, logging the access into the emulator's apu_log
+  void sound_write(nes_time_t, nes_addr_t, int data);
+  int sound_read(nes_time_t, nes_addr_t);
+
   // Reference to emulator that uses this mapper.
   Core &emu() const { return *emu_; }
 
@@ -190,6 +210,9 @@ class Mapper
 
   void default_reset_state();
 
+  // Supported mapper with given code, or NULL if there's none
+  static const mapper_info_t *getMapperInfo(const int mapperCode);
+
   static Mapper *getMapperFromCode(const int mapperCode);
 };
 
@@ -209,4 +232,6 @@ inline bool Mapper::write_intercepted(nes_time_t, nes_addr_t, int) { return fals
 
 inline int Mapper::read(nes_time_t, nes_addr_t) { return -1; } // signal to caller
 
+inline Expansion_Apu *Mapper::sound_chip() { return NULL; }
+
 } // namespace quickerNES
\ No newline at end of file
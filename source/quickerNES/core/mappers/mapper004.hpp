@@ -96,6 +96,29 @@ class Mapper004 : public Mapper, mmc3_state_t
     }
   }
 
+  // Same as clock_counter() count times
+  void clock_counter(long count)
+  {
+    counter_just_clocked = counter_just_clocked > count ? counter_just_clocked - count : 0;
+
+    if (count < irq_ctr)
+    {
+      irq_ctr -= count;
+      return;
+    }
+
+    // once at zero, the counter reloads and reaches zero again every irq_latch + 1 clocks
+    long after_zero = count - irq_ctr;
+    bool reached_zero = irq_ctr || after_zero > irq_latch;
+    if (after_zero)
+      irq_ctr = irq_latch - (after_zero - 1) % (irq_latch + 1);
+    else
+      irq_ctr = 0;
+
+    if (reached_zero)
+      irq_flag = irq_enabled;
+  }
+
   virtual void a12_clocked()
   {
     clock_counter();
@@ -139,13 +162,14 @@ class Mapper004 : public Mapper, mmc3_state_t
 
     if (next_time < 0) next_time = 0;
 
-    end_time *= ppu_overclock;
-    while (next_time < end_time && next_time <= last_scanline)
-    {
-      if (bg_enabled)
-        clock_counter();
-      next_time += Ppu::scanline_len;
-    }
+    // scanlines starting before end_time, up to the last one
+    nes_time_t last = std::min(end_time * ppu_overclock - 1, last_scanline);
+    if (next_time > last) return;
+
+    long count = (last - next_time) / Ppu::scanline_len + 1;
+    next_time += count * Ppu::scanline_len;
+    if (bg_enabled)
+      clock_counter(count);
   }
 
   void update_chr_banks()
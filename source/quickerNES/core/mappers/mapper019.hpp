@@ -44,11 +44,7 @@ class Mapper019 : public Mapper, namco106_state_t
     register_state(state, sizeof *state);
   }
 
-  virtual int channel_count() const { return sound.osc_count; }
-
-  virtual void set_channel_buf(int i, Blip_Buffer *b) { sound.osc_output(i, b); }
-
-  virtual void set_treble(blip_eq_t const &eq) { sound.treble_eq(eq); }
+  virtual Expansion_Apu *sound_chip() { return &sound; }
 
   void reset_state()
   {
@@ -108,13 +104,12 @@ class Mapper019 : public Mapper, namco106_state_t
     if (end_time > last_time)
       run_until(end_time);
     last_time -= end_time;
-    sound.end_frame(end_time);
   }
 
   virtual int read(nes_time_t time, nes_addr_t addr)
   {
     if (addr == 0x4800)
-      return sound.read_data();
+      return sound_read(time, addr);
 
     if (addr == 0x5000)
     {
@@ -135,7 +130,7 @@ class Mapper019 : public Mapper, namco106_state_t
   {
     if (addr == 0x4800)
     {
-      sound.write_data(time, data);
+      sound_write(time, addr, data);
     }
     else if (addr == 0x5000)
     {
@@ -157,7 +152,7 @@ class Mapper019 : public Mapper, namco106_state_t
     return true;
   }
 
-  virtual void write(nes_time_t, nes_addr_t addr, int data)
+  virtual void write(nes_time_t time, nes_addr_t addr, int data)
   {
     int reg = addr >> 11 & 0x0F;
     regs[reg] = data;
@@ -179,7 +174,7 @@ class Mapper019 : public Mapper, namco106_state_t
     }
     else
     {
-      sound.write_addr(data);
+      sound_write(time, 0xF800, data);
     }
   }
 
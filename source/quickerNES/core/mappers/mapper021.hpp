@@ -94,19 +94,19 @@ class Mapper_VRC2_4 : public Mapper, vrc2_state_t
 
   void reset_timer(nes_time_t present)
   {
-    next_time = present + unsigned((0x100 - irq_latch) * timer_period) / 4;
+    next_time = present + timer_length();
   }
 
+  unsigned timer_length() const { return unsigned((0x100 - irq_latch) * timer_period) / 4; }
+
   virtual void run_until(nes_time_t end_time)
   {
-    if (irq_control & 2)
+    // the timer restarts each time it expires
+    if ((irq_control & 2) && next_time < end_time)
     {
-      while (next_time < end_time)
-      {
-        // printf( "%d timer expired\n", next_time );
-        irq_pending = true;
-        reset_timer(next_time);
-      }
+      unsigned length = timer_length();
+      next_time += ((end_time - next_time - 1) / length + 1) * length;
+      irq_pending = true;
     }
   }
 
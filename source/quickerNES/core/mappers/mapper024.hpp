@@ -54,11 +54,7 @@ class Mapper_Vrc6 : public Mapper, vrc6_state_t
     register_state(state, sizeof *state);
   }
 
-  virtual int channel_count() const { return sound.osc_count; }
-
-  virtual void set_channel_buf(int i, Blip_Buffer *b) { sound.osc_output(i, b); }
-
-  virtual void set_treble(blip_eq_t const &eq) { sound.treble_eq(eq); }
+  virtual Expansion_Apu *sound_chip() { return &sound; }
 
   virtual void reset_state()
   {
@@ -86,19 +82,19 @@ class Mapper_Vrc6 : public Mapper, vrc6_state_t
 
   void reset_timer(nes_time_t present)
   {
-    next_time = present + unsigned((0x100 - irq_reload) * timer_period) / 4;
+    next_time = present + timer_length();
   }
 
+  unsigned timer_length() const { return unsigned((0x100 - irq_reload) * timer_period) / 4; }
+
   virtual void run_until(nes_time_t end_time)
   {
-    if (irq_mode & 2)
+    // the timer restarts each time it expires
+    if ((irq_mode & 2) && next_time < end_time)
     {
-      while (next_time < end_time)
-      {
-        // dprintf( "%d timer expired\n", next_time );
-        irq_pending = true;
-        reset_timer(next_time);
-      }
+      unsigned length = timer_length();
+      next_time += ((end_time - next_time - 1) / length + 1) * length;
+      irq_pending = true;
     }
   }
 
@@ -108,8 +104,6 @@ class Mapper_Vrc6 : public Mapper, vrc6_state_t
 
     // to do: next_time might go negative if IRQ is disabled
     next_time -= end_time;
-
-    sound.end_frame(end_time);
   }
 
   virtual nes_time_t next_irq(nes_time_t present)
@@ -132,12 +126,13 @@ class Mapper_Vrc6 : public Mapper, vrc6_state_t
 
     int reg = addr & 3;
     if ((unsigned)osc < sound.osc_count && reg < sound.reg_count)
-      sound.write_osc(time, osc, reg, data);
+      sound_write(time, addr, data);
     else if (addr < 0xf000)
       write_bank(addr, data);
     else
       write_irq(time, addr, data);
   }
+
   int swap_mask;
   Vrc6_Apu sound;
   enum
@@ -151,7 +146,7 @@ class Mapper_Vrc6 : public Mapper, vrc6_state_t
 
     // to do: eliminate when format is updated
     // old-style registers
-    static char zero[sizeof old_sound_regs] = {0};
+    static const char zero[sizeof old_sound_regs] = {0};
     if (0 != memcmp(old_sound_regs, zero, sizeof zero))
     {
       /* Using old VRC6 sound register format */
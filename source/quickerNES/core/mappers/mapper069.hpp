@@ -46,11 +46,7 @@ class Mapper069 : public Mapper, fme7_state_t
     register_state(state, sizeof *state);
   }
 
-  virtual int channel_count() const { return sound.osc_count; }
-
-  virtual void set_channel_buf(int i, Blip_Buffer *b) { sound.osc_output(i, b); }
-
-  virtual void set_treble(blip_eq_t const &eq) { sound.treble_eq(eq); }
+  virtual Expansion_Apu *sound_chip() { return &sound; }
 
   virtual void reset_state()
   {
@@ -107,8 +103,6 @@ class Mapper069 : public Mapper, fme7_state_t
       run_until(end_time);
 
     last_time -= end_time;
-
-    sound.end_frame(end_time);
   }
 
   virtual void write(nes_time_t time, nes_addr_t addr, int data)
@@ -127,11 +121,8 @@ class Mapper069 : public Mapper, fme7_state_t
       break;
 
     case 0xC000:
-      sound.write_latch(data);
-      break;
-
     case 0xE000:
-      sound.write_data(time, data);
+      sound_write(time, addr & 0xE000, data);
       break;
     }
   }
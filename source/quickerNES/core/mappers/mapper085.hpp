@@ -49,11 +49,7 @@ class Mapper085 : public Mapper, vrc7_state_t
     register_state(state, sizeof *state);
   }
 
-  virtual int channel_count() const { return sound.osc_count; }
-
-  virtual void set_channel_buf(int i, Blip_Buffer *b) { sound.osc_output(i, b); }
-
-  virtual void set_treble(blip_eq_t const &eq) { sound.treble_eq(eq); }
+  virtual Expansion_Apu *sound_chip() { return &sound; }
 
   virtual void save_state(mapper_state_t &out)
   {
@@ -129,19 +125,19 @@ class Mapper085 : public Mapper, vrc7_state_t
 
   void reset_timer(nes_time_t present)
   {
-    next_time = present + unsigned((0x100 - irq_reload) * timer_period) / 4;
+    next_time = present + timer_length();
   }
 
+  unsigned timer_length() const { return unsigned((0x100 - irq_reload) * timer_period) / 4; }
+
   virtual void run_until(nes_time_t end_time)
   {
-    if (irq_mode & 2)
+    // the timer restarts each time it expires
+    if ((irq_mode & 2) && next_time < end_time)
     {
-      while (next_time < end_time)
-      {
-        // dprintf( "%d timer expired\n", next_time );
-        irq_pending = true;
-        reset_timer(next_time);
-      }
+      unsigned length = timer_length();
+      next_time += ((end_time - next_time - 1) / length + 1) * length;
+      irq_pending = true;
     }
   }
 
@@ -150,8 +146,6 @@ class Mapper085 : public Mapper, vrc7_state_t
     run_until(end_time);
 
     next_time -= end_time;
-
-    sound.end_frame(end_time);
   }
 
   virtual nes_time_t next_irq(nes_time_t present)
@@ -210,10 +204,7 @@ class Mapper085 : public Mapper, vrc7_state_t
         break;
 
       case 0x9010:
-        if (addr & 0x20)
-          sound.write_data(time, data);
-        else
-          sound.write_reg(data);
+        sound_write(time, addr & 0xF030, data);
         break;
       }
   }
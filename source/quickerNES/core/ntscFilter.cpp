@@ -0,0 +1,213 @@
+// NTSC composite video filter for the emulator's indexed frames
+
+#include "ntscFilter.hpp"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+  #define NES_NTSC_X86_SIMD 1
+  #include <immintrin.h>
+#endif
+
+namespace quickerNES
+{
+
+// The PPU outputs 8 samples per pixel and 12 per color subcarrier cycle, so the subcarrier phase
+// of a pixel's first sample is one of 3. Each output pixel decodes the cycle of samples centered
+// on it; output pixels are 24 / 7 samples apart.
+static const int samples_per_pixel = 8;
+static const int samples_per_cycle = 12;
+static const int group_samples = 3 * samples_per_pixel;
+static const int group_outputs = 7;
+
+static int output_center(int j)
+{
+  // rounds toward negative infinity for the pixel before the first one
+  int n = j * group_samples;
+  return (n >= 0 ? n : n - (group_outputs - 1)) / group_outputs;
+}
+
+Ntsc_Filter::~Ntsc_Filter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+const char *Ntsc_Filter::init(Emu::pixel_format_t format, int thread_count_, double hue, double saturation)
+{
+  if (format == Emu::pixels_indexed8) return "NTSC filter output must be 32-bit";
+  if (thread_count_ < 1) return "Invalid thread count";
+
+  // restart workers from scratch
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+  workers.clear();
+  quit = false;
+
+  kernels.assign(3 * 3 * Emu::color_table_size * kernel_size, 0);
+
+  int const red = (format == Emu::pixels_rgba32) ? 0 : 2;
+  double const pi = 3.14159265358979323846;
+  double const hue_shift = hue * pi;
+  for (int position = 0; position < 3; position++)
+  {
+    // output pixels whose cycle of samples overlaps this pixel's samples
+    int const begin = position * samples_per_pixel;
+    int first = -group_outputs;
+    while (output_center(first) + samples_per_cycle / 2 <= begin)
+      first++;
+    first_output[position] = first;
+
+    for (int phase = 0; phase < 3; phase++)
+    {
+      for (int color = 0; color < Emu::color_table_size; color++)
+      {
+        Emu::rgb_t const &rgb = Emu::nes_colors[color];
+        double const y = 0.299 * rgb.red + 0.587 * rgb.green + 0.114 * rgb.blue;
+        double const i = 0.595716 * rgb.red - 0.274453 * rgb.green - 0.321263 * rgb.blue;
+        double const q = 0.211456 * rgb.red - 0.522591 * rgb.green + 0.311135 * rgb.blue;
+
+        int16_t *out = &kernels[((phase * 3 + position) * Emu::color_table_size + color) * kernel_size];
+        for (int n = 0; n < kernel_size / 4; n++)
+        {
+          int const center = output_center(first + n);
+          double out_y = 0, out_i = 0, out_q = 0;
+          for (int s = center - samples_per_cycle / 2; s < center + samples_per_cycle / 2; s++)
+          {
+            if (s < begin || s >= begin + samples_per_pixel) continue;
+
+            double const angle = pi * (phase * 4 + s - begin) / (samples_per_cycle / 2);
+            double const signal = y + i * cos(angle) + q * sin(angle);
+            out_y += signal;
+            out_i += signal * cos(angle + hue_shift);
+            out_q += signal * sin(angle + hue_shift);
+          }
+          out_y *= 1.0 / samples_per_cycle;
+          out_i *= 2.0 * saturation / samples_per_cycle;
+          out_q *= 2.0 * saturation / samples_per_cycle;
+
+          // channels are kept in 1/8 units
+          double const r = out_y + 0.9563 * out_i + 0.6210 * out_q;
+          double const g = out_y - 0.2721 * out_i - 0.6474 * out_q;
+          double const b = out_y - 1.1070 * out_i + 1.7046 * out_q;
+          out[n * 4 + red] = (int16_t)lrint(r * 8);
+          out[n * 4 + 1] = (int16_t)lrint(g * 8);
+          out[n * 4 + 2 - red] = (int16_t)lrint(b * 8);
+          out[n * 4 + 3] = 0;
+        }
+      }
+    }
+  }
+
+  thread_count = thread_count_;
+  for (int band = 1; band < thread_count; band++)
+    workers.emplace_back(&Ntsc_Filter::run_worker, this, band, generation);
+  return 0;
+}
+
+const char *Ntsc_Filter::blit(Emu::frame_t const &frame_, void *out_, long out_row_bytes_)
+{
+  if (thread_count == 0) return "NTSC filter not initialized";
+
+  frame = &frame_;
+  out = (uint8_t *)out_;
+  out_row_bytes = out_row_bytes_;
+
+  if (thread_count > 1)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = thread_count - 1;
+    generation++;
+  }
+  cond.notify_all();
+
+  filter_rows(0, out_height / thread_count);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this] { return pending == 0; });
+  return 0;
+}
+
+void Ntsc_Filter::run_worker(int band, uint64_t done)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    cond.wait(lock, [&] { return generation != done || quit; });
+    if (quit) return;
+    done = generation;
+
+    lock.unlock();
+    filter_rows(out_height * band / thread_count, out_height * (band + 1) / thread_count);
+    lock.lock();
+
+    if (--pending == 0) cond.notify_all();
+  }
+}
+
+void Ntsc_Filter::filter_rows(int begin, int end)
+{
+  // output pixel j accumulates at j + margin, as the first kernel starts before it
+  int const margin = 2;
+  alignas(16) int16_t acc[(out_width + margin + kernel_size / 4) * 4];
+
+  for (int row = begin; row < end; row++)
+  {
+    uint8_t const *in = frame->pixels + row * frame->pitch;
+    int const burst = (frame->burst_phase + row) % 3;
+    int16_t const *position_kernels[3];
+    for (int position = 0; position < 3; position++)
+      position_kernels[position] = kernel((burst + 2 * position) % 3, position, 0);
+
+    memset(acc, 0, sizeof acc);
+    for (int x = 0; x < Emu::image_width; x++)
+    {
+      int const position = x % 3;
+      int16_t const *k = position_kernels[position] + frame->palette[in[x]] * kernel_size;
+      int16_t *a = &acc[(x / 3 * group_outputs + first_output[position] + margin) * 4];
+#if NES_NTSC_X86_SIMD
+      for (int n = 0; n < kernel_size; n += 8)
+        _mm_storeu_si128((__m128i *)&a[n], _mm_add_epi16(_mm_loadu_si128((__m128i const *)&a[n]), _mm_loadu_si128((__m128i const *)&k[n])));
+#else
+      for (int n = 0; n < kernel_size; n++)
+        a[n] += k[n];
+#endif
+    }
+
+    // round, clamp and set alpha
+    uint8_t *o = out + row * out_row_bytes;
+    int16_t const *a = &acc[margin * 4];
+    int j = 0;
+#if NES_NTSC_X86_SIMD
+    __m128i const round = _mm_set1_epi16(4);
+    __m128i const alpha = _mm_set1_epi32((int)0xFF000000);
+    for (; j + 4 <= out_width; j += 4)
+    {
+      __m128i lo = _mm_srai_epi16(_mm_add_epi16(_mm_load_si128((__m128i const *)&a[j * 4]), round), 3);
+      __m128i hi = _mm_srai_epi16(_mm_add_epi16(_mm_load_si128((__m128i const *)&a[j * 4 + 8]), round), 3);
+      _mm_storeu_si128((__m128i *)&o[j * 4], _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+    }
+#endif
+    for (; j < out_width; j++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        int v = (a[j * 4 + c] + 4) >> 3;
+        o[j * 4 + c] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+      o[j * 4 + 3] = 0xFF;
+    }
+  }
+}
+
+} // namespace quickerNES
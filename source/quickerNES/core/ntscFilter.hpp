@@ -0,0 +1,71 @@
+#pragma once
+
+// NTSC composite video filter for the emulator's indexed frames
+
+#include "emu.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace quickerNES
+{
+
+// Simulates the NES composite signal going through a TV's decoder: each color is encoded at the
+// color subcarrier phase of every one of its 8 samples per pixel, and each output pixel decodes
+// a full subcarrier cycle of samples around it. Flat areas keep the colors of nes_colors, while
+// edges and dithering show the color fringes and blending of a real TV. Three input pixels make
+// seven output pixels, and the subcarrier phase moves with the frame's burst_phase and with each
+// scanline, as on the NES.
+//
+// Output pixels are summed from precomputed per-color kernels, with SSE2 where available, and
+// rows are divided into bands filtered on separate threads.
+class Ntsc_Filter
+{
+  public:
+  static const uint16_t out_width = (Emu::image_width / 3 + 1) * 7; // 602
+  static const uint16_t out_height = Emu::image_height;
+
+  Ntsc_Filter() {}
+  ~Ntsc_Filter();
+
+  // Builds the kernels for 32-bit output in the given format, with the decoder's hue rotated by
+  // hue (-1 to 1 for -180 to 180 degrees) and color scaled by saturation (0 for grayscale).
+  // Frames are filtered on thread_count threads, the calling one included.
+  const char *init(Emu::pixel_format_t format = Emu::pixels_rgba32, int thread_count = 1, double hue = 0.0, double saturation = 1.0);
+
+  // Filters an indexed frame into out_width x out_height 32-bit pixels. Fails if init() hasn't
+  // succeeded yet.
+  const char *blit(Emu::frame_t const &frame, void *out, long out_row_bytes);
+
+  private:
+  // kernels of 8 output pixels by 4 channels, for each subcarrier phase (of 3) of a pixel, position
+  // of the pixel in its group of 3, and NES color
+  static const uint8_t kernel_size = 8 * 4;
+  std::vector<int16_t> kernels;
+  int first_output[3]; // first output pixel of each position's kernel, relative to its group
+
+  int16_t const *kernel(int phase, int position, int color) const
+  {
+    return &kernels[((phase * 3 + position) * Emu::color_table_size + color) * kernel_size];
+  }
+
+  void filter_rows(int begin, int end);
+  void run_worker(int band, uint64_t done);
+
+  // current job
+  Emu::frame_t const *frame = nullptr;
+  uint8_t *out = nullptr;
+  long out_row_bytes = 0;
+
+  int thread_count = 0;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable cond;
+  uint64_t generation = 0; // incremented for each frame handed to the workers
+  int pending = 0;         // workers not done with the current frame
+  bool quit = false;
+};
+
+} // namespace quickerNES
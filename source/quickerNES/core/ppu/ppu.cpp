@@ -50,6 +50,8 @@ nes_time_t const earliest_vbl_end_time = max_frame_length / ppu_overclock - 10;
 
 void Ppu::render_bg_until_(nes_time_t cpu_time)
 {
+  NES_STAT(emu.stats.ppu_bg_renders++);
+
   ppu_time_t time = ppu_time(cpu_time);
   ppu_time_t const frame_duration = scanline_len * 261;
   if (time > frame_duration)
@@ -137,6 +139,16 @@ void Ppu::render_until_(nes_time_t time)
       next_sprites_scanline += count;
       draw_sprites(start, count);
     }
+
+    // 32-bit and observation output wait for the first palette of the frame, which may only be
+    // captured on its last scanline
+    if (host_pixels32 && palette_size)
+    {
+      convert_scanlines(next_convert_scanline, next_sprites_scanline - next_convert_scanline);
+      next_convert_scanline = next_sprites_scanline;
+    }
+    if (obs_pixels && palette_size)
+      sample_observation(next_sprites_scanline);
   }
 }
 
@@ -178,6 +190,8 @@ inline void Ppu::invalidate_sprite_max_()
 
 void Ppu::run_sprite_max_(nes_time_t cpu_time)
 {
+  NES_STAT(emu.stats.ppu_sprite_max++);
+
   end_vblank(); // might get run outside $2002 handler
 
   // 577.0 / 0x10000 ~= 1.0 / 113.581, close enough to accurately calculate which scanline it is
@@ -244,6 +258,8 @@ inline int Ppu_Impl::first_opaque_sprite_line()
 
 void Ppu::update_sprite_hit(nes_time_t cpu_time)
 {
+  NES_STAT(emu.stats.ppu_sprite_hits++);
+
   ppu_time_t earliest = earliest_sprite_hit + spr_ram[0] * scanline_len + spr_ram[3];
   // ppu_time_t latest = earliest + sprite_height() * scanline_len;
 
@@ -426,7 +442,7 @@ int Ppu::read(unsigned addr, nes_time_t time)
     int addr = vram_addr;
     int new_addr = addr + addr_inc;
     vram_addr = new_addr;
-    if (~addr & new_addr & vaddr_clock_mask)
+    if ((~addr & new_addr & vaddr_clock_mask) && (emu.mapper_caps & mapper_a12))
     {
       emu.mapper->a12_clocked();
       addr = vram_addr - addr_inc; // avoid having to save across func call
@@ -503,7 +519,7 @@ void Ppu::write(nes_time_t time, unsigned addr, int data)
     else if (changed & 0x0A)
       render_bg_until(time + 1); // bg enable/clipping changed
 
-    if (changed & 0x08) // bg enabled changed
+    if ((changed & 0x08) && (emu.mapper_caps & mapper_irq)) // bg enabled changed
       emu.mapper->run_until(time);
 
     if (!(w2001 & 0x18) != !(data & 0x18))
@@ -557,7 +573,7 @@ void Ppu::write(nes_time_t time, unsigned addr, int data)
     {
       int changed = ~vram_addr & vram_temp;
       vram_addr = vram_temp = (vram_temp & 0xff00) | data;
-      if (changed & vaddr_clock_mask)
+      if ((changed & vaddr_clock_mask) && (emu.mapper_caps & mapper_a12))
         emu.mapper->a12_clocked();
     }
     break;
@@ -570,6 +586,14 @@ void Ppu::write(nes_time_t time, unsigned addr, int data)
   poke_open_bus(time, data, ~0);
 }
 
+nes_time_t Ppu::scanline_start_time(int scanline) const
+{
+  int line = scanline >= 241 ? scanline - 241 : scanline + 21;
+  ppu_time_t t = line * scanline_len - extra_clocks;
+  if (t < 0) t = 0;
+  return (t + ppu_overclock - 1) / ppu_overclock;
+}
+
 // Frame begin/end
 
 nes_time_t Ppu::begin_frame(ppu_time_t timestamp)
@@ -598,6 +622,8 @@ nes_time_t Ppu::begin_frame(ppu_time_t timestamp)
   // sprite rendering
   next_sprites_scanline = 0;
   next_sprites_time = 0;
+  next_convert_scanline = 0;
+  next_observation_row = 0;
 
   // status register
   frame_ended = false;
@@ -40,6 +40,10 @@ class Ppu : public Ppu_Rendering
   // CPU time that frame will have ended by
   int frame_length() const { return frame_length_; }
 
+  // CPU time at which a scanline (-1 to 260) starts in the current frame. Frames begin at
+  // the start of vertical blank, so scanlines 241 to 260 come first.
+  nes_time_t scanline_start_time(int scanline) const;
+
   // End frame rendering and return PPU timestamp for next frame
   ppu_time_t end_frame(nes_time_t);
 
@@ -85,6 +89,7 @@ class Ppu : public Ppu_Rendering
   // sprite rendering
   ppu_time_t next_sprites_time;
   int next_sprites_scanline;
+  int next_convert_scanline; // 32-bit output
   void render_until_(nes_time_t);
 
   // $2002 status register
@@ -5,8 +5,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <bit>
 #include <new>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+  #define NES_PPU_X86_SIMD 1
+  #include <immintrin.h>
+#endif
+
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -40,8 +47,11 @@ Ppu_Impl::Ppu_Impl()
   chr_size = 0;
   tile_cache = NULL;
   host_palette = NULL;
+  color_lut = NULL;
   max_palette_size = 0;
   tile_cache_mem = NULL;
+  rom_tiles = NULL;
+  sprite_rows_height = 0;
   ppu_state_t::unused = 0;
 
   mmc24_enabled = false;
@@ -61,7 +71,43 @@ void Ppu_Impl::all_tiles_modified()
   memset(modified_tiles, ~0, sizeof modified_tiles);
 }
 
-const char *Ppu_Impl::open_chr(uint8_t const *new_chr, long chr_data_size)
+static inline bool tile_differs(uint8_t const *a, uint8_t const *b)
+{
+#ifdef NES_PPU_X86_SIMD
+  __m128i x = _mm_loadu_si128((__m128i const *)a);
+  __m128i y = _mm_loadu_si128((__m128i const *)b);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF;
+#else
+  return memcmp(a, b, 16) != 0;
+#endif
+}
+
+void Ppu_Impl::load_chr_ram(uint8_t const *in)
+{
+  static_assert(bytes_per_tile == 16, "tile comparison assumes 16-byte tiles");
+  uint8_t *chr = impl->chr_ram;
+  for (int chunk = 0; chunk < chr_tile_count / 8; chunk++)
+  {
+    int changed = 0;
+    for (int i = 0; i < 8; i++)
+    {
+      long offset = (chunk * 8 + i) * bytes_per_tile;
+      if (tile_differs(chr + offset, in + offset))
+      {
+        memcpy(chr + offset, in + offset, bytes_per_tile);
+        changed |= 1 << i;
+      }
+    }
+
+    if (changed)
+    {
+      modified_tiles[chunk] |= changed;
+      any_tiles_modified = true;
+    }
+  }
+}
+
+const char *Ppu_Impl::open_chr(uint8_t const *new_chr, long chr_data_size, Tile_Cache *new_rom_tiles)
 {
   close_chr();
 
@@ -84,6 +130,16 @@ const char *Ppu_Impl::open_chr(uint8_t const *new_chr, long chr_data_size)
     chr_is_writable = true;
   }
 
+  // CHR ROM tiles come from the cartridge's shared cache, decoded as banks get mapped
+  if (!chr_is_writable)
+  {
+    rom_tiles = new_rom_tiles;
+    tile_cache = (cached_tile_t *)rom_tiles->tiles();
+    flipped_tiles = (cached_tile_t *)rom_tiles->flipped_tiles();
+    any_tiles_modified = false;
+    return 0;
+  }
+
   // allocate aligned memory for cache
   long tile_count = chr_size / bytes_per_tile;
   tile_cache_mem = (uint8_t *)calloc(tile_count * sizeof(cached_tile_t) * 2 + cache_line_size, sizeof(uint8_t));
@@ -94,11 +150,6 @@ const char *Ppu_Impl::open_chr(uint8_t const *new_chr, long chr_data_size)
 
   // rebuild cache
   all_tiles_modified();
-  if (!chr_is_writable)
-  {
-    any_tiles_modified = false;
-    rebuild_chr(0, chr_size);
-  }
 
   return 0;
 }
@@ -107,6 +158,7 @@ void Ppu_Impl::close_chr()
 {
   free(tile_cache_mem);
   tile_cache_mem = NULL;
+  rom_tiles = NULL;
 }
 
 void Ppu_Impl::set_chr_bank(int addr, int size, long data)
@@ -116,6 +168,9 @@ void Ppu_Impl::set_chr_bank(int addr, int size, long data)
 
   int count = (unsigned)size / chr_page_size;
 
+  if (rom_tiles)
+    rom_tiles->require(data, size);
+
   int page = (unsigned)addr / chr_page_size;
   while (count--)
   {
@@ -139,6 +194,9 @@ void Ppu_Impl::set_chr_bank_ex(int addr, int size, long data)
   // assert( chr_page_size * count == size );
   // assert( addr + size <= chr_addr_size );
 
+  if (rom_tiles)
+    rom_tiles->require(data, size);
+
   int page = (unsigned)addr / chr_page_size;
   while (count--)
   {
@@ -148,6 +206,35 @@ void Ppu_Impl::set_chr_bank_ex(int addr, int size, long data)
   }
 }
 
+// Pages are only set by the functions above, so pages already mapped have their tiles available
+
+bool Ppu_Impl::chr_pages_mapped(long const *pages, int addr, int size, long data) const
+{
+  if (data + size > chr_size)
+    data %= chr_size;
+
+  int count = (unsigned)size / chr_page_size;
+  int page = (unsigned)addr / chr_page_size;
+  while (count--)
+  {
+    if (pages[page] != data - page * chr_page_size)
+      return false;
+    page++;
+    data += chr_page_size;
+  }
+  return true;
+}
+
+bool Ppu_Impl::chr_bank_mapped(int addr, int size, long data) const
+{
+  return chr_pages_mapped(chr_pages, addr, size, data);
+}
+
+bool Ppu_Impl::chr_bank_ex_mapped(int addr, int size, long data) const
+{
+  return mmc24_enabled && chr_pages_mapped(chr_pages_ex, addr, size, data);
+}
+
 static uint8_t const initial_palette[0x20] =
   {
     0x0f, 0x01, 0x00, 0x01, 0x00, 0x02, 0x02, 0x0D, 0x08, 0x10, 0x08, 0x24, 0x00, 0x00, 0x04, 0x2C, 0x00, 0x01, 0x34, 0x03, 0x00, 0x04, 0x00, 0x14, 0x00, 0x3A, 0x00, 0x02, 0x00, 0x20, 0x2C, 0x08};
@@ -204,6 +291,13 @@ void Ppu_Impl::capture_palette()
       out[i] = bg;
 
     memcpy(out + 32, out, 32 * sizeof *out);
+
+    if (color_lut)
+    {
+      uint32_t *colors = &host_colors[palette_begin + palette_size - palette_increment];
+      for (i = 0; i < palette_increment; i++)
+        colors[i] = color_lut[out[i]];
+    }
   }
 }
 
@@ -239,12 +333,8 @@ inline unsigned long reorder(unsigned long n)
   return ((n << 14) | n);
 }
 
-inline void Ppu_Impl::update_tile(int index)
+void Tile_Cache::decode(uint8_t const *in, uint8_t *out, uint8_t *flipped_out)
 {
-  const uint8_t *in = chr_data + (index)*bytes_per_tile;
-  uint8_t *out = (uint8_t *)tile_cache[index];
-  uint8_t *flipped_out = (uint8_t *)flipped_tiles[index];
-
   unsigned long bit_mask = 0x11111111 + zero;
 
   for (int n = 4; n--;)
@@ -278,8 +368,62 @@ inline void Ppu_Impl::update_tile(int index)
   }
 }
 
+const char *Tile_Cache::init(uint8_t const *new_chr, long new_size)
+{
+  free(mem);
+  mem = NULL;
+  tiles_ = NULL;
+  built.reset();
+
+  chr = new_chr;
+  size_ = new_size;
+  bank_count = (new_size + bank_size - 1) / bank_size;
+  if (!new_size) return 0;
+
+  // allocate aligned memory; pages of banks never mapped are never touched
+  mem = (uint8_t *)calloc(size_ * 2 + cache_line_size, sizeof(uint8_t));
+  if (!mem) return "Out of memory";
+  tiles_ = mem + cache_line_size - (uintptr_t)mem % cache_line_size;
+
+  built.reset(new (std::nothrow) std::atomic<bool>[bank_count]);
+  if (!built) return "Out of memory";
+  for (long bank = 0; bank < bank_count; bank++) built[bank].store(false, std::memory_order_relaxed);
+  return 0;
+}
+
+void Tile_Cache::build(long bank)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (built[bank].load(std::memory_order_relaxed)) return;
+
+  long end = std::min((bank + 1) * (long)bank_size, size_);
+  for (long offset = bank * bank_size; offset < end; offset += bytes_per_tile)
+    decode(chr + offset, tiles() + offset, flipped_tiles() + offset);
+  built[bank].store(true, std::memory_order_release);
+}
+
+void Tile_Cache::rebuild(unsigned long begin, unsigned long end)
+{
+  // banks not decoded yet will see the new data once required
+  if ((long)end > size_) end = size_;
+  for (unsigned long offset = begin & ~(bytes_per_tile - 1UL); offset < end; offset += bytes_per_tile)
+    if (built[offset / bank_size].load(std::memory_order_acquire))
+      decode(chr + offset, tiles() + offset, flipped_tiles() + offset);
+}
+
+inline void Ppu_Impl::update_tile(int index)
+{
+  Tile_Cache::decode(chr_data + index * bytes_per_tile, (uint8_t *)tile_cache[index], (uint8_t *)flipped_tiles[index]);
+}
+
 void Ppu_Impl::rebuild_chr(unsigned long begin, unsigned long end)
 {
+  if (rom_tiles)
+  {
+    rom_tiles->rebuild(begin, end);
+    return;
+  }
+
   unsigned end_index = (end + bytes_per_tile - 1) / bytes_per_tile;
   for (unsigned index = begin / bytes_per_tile; index < end_index; index++)
     update_tile(index);
@@ -316,122 +460,87 @@ void Ppu_Impl::update_tiles(int first_tile)
   } while (chunk < chr_tile_count / 8);
 }
 
-// Sprite max
+// Sprite evaluation
 
-template <int height>
-struct calc_sprite_max_scanlines
+bool Ppu_Impl::sprite_rows_stale()
 {
-  static unsigned long func(uint8_t const *sprites, uint8_t *scanlines, int begin)
+  if (sprite_rows_height != sprite_height())
+    return true;
+
+#if NES_PPU_X86_SIMD
+  // gather the Y position of 16 sprites at a time and compare with those last built from
+  __m128i const y_mask = _mm_set1_epi32(0xff);
+  int differs = 0;
+  for (int n = 0; n < spr_ram_size; n += 64)
   {
-    unsigned long any_hits = 0;
-    unsigned long const offset = 0x01010101 + zero;
-    unsigned limit = 239 + height - begin;
-    for (int n = 64; n; --n)
-    {
-      int top = *sprites;
-      sprites += 4;
-      uint8_t *p = scanlines + top;
-      if ((unsigned)(239 - top) < limit)
-      {
-        unsigned long p0 = ((uint32_t *)p)[0] + offset;
-        unsigned long p4 = ((uint32_t *)p)[1] + offset;
-        ((uint32_t *)p)[0] = p0;
-        any_hits |= p0;
-        ((uint32_t *)p)[1] = p4;
-        any_hits |= p4;
-        if (height > 8)
-        {
-          unsigned long p0 = ((uint32_t *)p)[2] + offset;
-          unsigned long p4 = ((uint32_t *)p)[3] + offset;
-          ((uint32_t *)p)[2] = p0;
-          any_hits |= p0;
-          ((uint32_t *)p)[3] = p4;
-          any_hits |= p4;
-        }
-      }
-    }
-
-    return any_hits;
+    __m128i const *in = (__m128i const *)&spr_ram[n];
+    __m128i low = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(in + 0), y_mask), _mm_and_si128(_mm_loadu_si128(in + 1), y_mask));
+    __m128i high = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(in + 2), y_mask), _mm_and_si128(_mm_loadu_si128(in + 3), y_mask));
+    __m128i tops = _mm_packus_epi16(low, high);
+    __m128i built = _mm_loadu_si128((__m128i const *)&sprite_rows_top[n / 4]);
+    differs |= _mm_movemask_epi8(_mm_cmpeq_epi8(tops, built)) ^ 0xffff;
   }
-};
+  return differs != 0;
+#else
+  for (int i = 0; i < spr_ram_size / 4; i++)
+    if (sprite_rows_top[i] != spr_ram[i * 4])
+      return true;
+  return false;
+#endif
+}
 
-long Ppu_Impl::recalc_sprite_max(int scanline)
+void Ppu_Impl::build_sprite_rows()
 {
-  int const max_scanline_count = image_height;
-
-  uint8_t sprite_max_scanlines[256 + 16];
+  int const height = sprite_height();
+  sprite_rows_height = height;
+  memset(sprite_rows_, 0, sizeof sprite_rows_);
+  for (int i = 0; i < spr_ram_size / 4; i++)
+  {
+    int top = spr_ram[i * 4];
+    sprite_rows_top[i] = top;
+    int end = std::min(top + height, (int)image_height);
+    for (int row = top; row < end; row++)
+      sprite_rows_[row] |= (uint64_t)1 << i;
+  }
 
-  // recalculate sprites per scanline
-  memset(sprite_max_scanlines + scanline, 0x78, last_sprite_max_scanline - scanline);
-  unsigned long any_hits;
-  if (w2000 & 0x20)
-    any_hits = calc_sprite_max_scanlines<16>::func(spr_ram, sprite_max_scanlines, scanline);
-  else
-    any_hits = calc_sprite_max_scanlines<8>::func(spr_ram, sprite_max_scanlines, scanline);
+  first_crowded_row = 0;
+  while (first_crowded_row < image_height && std::popcount(sprite_rows_[first_crowded_row]) < 8)
+    first_crowded_row++;
+}
 
-  // cause search to terminate past max_scanline_count if none have 8 or more sprites
-  (uint32_t &)sprite_max_scanlines[max_scanline_count] = 0;
-  sprite_max_scanlines[max_scanline_count + 3] = 0x80;
+// Sprite max
 
-  // avoid scan if no possible hits
-  if (!(any_hits & 0x80808080))
-    return 0;
+long Ppu_Impl::recalc_sprite_max(int scanline)
+{
+  uint64_t const *rows = sprite_rows();
+  int const height = sprite_height();
 
   // find soonest scanline with 8 or more sprites
-  while (true)
+  for (scanline = std::max(scanline, first_crowded_row); scanline < image_height; scanline++)
   {
-    unsigned long const mask = 0x80808080 + zero;
-
-    // check four at a time
-    uint8_t *pos = &sprite_max_scanlines[scanline];
-    unsigned long n = *((uint32_t *)pos);
-    while (1)
-    {
-      unsigned long x = n & mask;
-      pos += 4;
-      n = *((uint32_t *)pos);
-      if (x)
-        break;
-    }
-
-    int height = sprite_height();
-    int remain = 8;
-    int i = 0;
-
-    // find which of the four
-    pos -= 3 + (pos[-4] >> 7 & 1);
-    pos += 1 - (*pos >> 7 & 1);
-    pos += 1 - (*pos >> 7 & 1);
-
-    scanline = pos - sprite_max_scanlines;
-    if (scanline >= max_scanline_count)
-      break;
+    uint64_t in_range = rows[scanline];
+    if (std::popcount(in_range) < 8)
+      continue;
 
     // find time that max sprites flag is set (or that it won't be set)
-    do
+    for (int n = 7; n; --n)
+      in_range &= in_range - 1;
+    int i = (std::countr_zero(in_range) + 1) * 4;
+
+    // now use screwey search for 9th sprite
+    int offset = 0;
+    while (i < 0x100)
     {
-      int relative = scanline - spr_ram[i];
+      int relative = scanline - spr_ram[i + offset];
+      // dprintf( "Checking sprite %d [%d]\n", i / 4, offset );
       i += 4;
-      if ((unsigned)relative < (unsigned)height && !--remain)
+      offset = (offset + 1) & 3;
+      if ((unsigned)relative < (unsigned)height)
       {
-        // now use screwey search for 9th sprite
-        int offset = 0;
-        while (i < 0x100)
-        {
-          int relative = scanline - spr_ram[i + offset];
-          // dprintf( "Checking sprite %d [%d]\n", i / 4, offset );
-          i += 4;
-          offset = (offset + 1) & 3;
-          if ((unsigned)relative < (unsigned)height)
-          {
-            // dprintf( "sprite max on scanline %d\n", scanline );
-            return scanline * scanline_len + (unsigned)i / 2;
-          }
-        }
-        break;
+        // dprintf( "sprite max on scanline %d\n", scanline );
+        return scanline * scanline_len + (unsigned)i / 2;
       }
-    } while (i < 0x100);
-    scanline++;
+    }
   }
 
   return 0;
@@ -3,6 +3,7 @@
 // NES PPU misc functions and setup
 // Emu 0.7.0
 
+#include "tileCache.hpp"
 #include <stdint.h>
 
 namespace quickerNES
@@ -37,7 +38,7 @@ class Ppu_Impl : public ppu_state_t
   void reset(bool full_reset);
 
   // Setup
-  const char *open_chr(const uint8_t *, long size);
+  const char *open_chr(const uint8_t *, long size, Tile_Cache *rom_tiles);
   void rebuild_chr(unsigned long begin, unsigned long end);
   void close_chr();
 
@@ -60,6 +61,8 @@ class Ppu_Impl : public ppu_state_t
   // Host palette
   static const uint8_t palette_increment = 64;
   short *host_palette;
+  uint32_t const *color_lut; // NES colors (with emphasis) to 32-bit host colors; null for indexed output
+  uint32_t host_colors[256]; // host palette entries to 32-bit host colors, kept by capture_palette()
   int palette_begin;
   int max_palette_size;
   int palette_size; // set after frame is rendered
@@ -70,6 +73,11 @@ class Ppu_Impl : public ppu_state_t
   void set_chr_bank(int addr, int size, long data);
   void set_chr_bank_ex(int addr, int size, long data);
 
+  // True if setting the banks would leave the mapping as it is
+  bool nt_banks_mapped(int bank0, int bank1, int bank2, int bank3) const;
+  bool chr_bank_mapped(int addr, int size, long data) const;
+  bool chr_bank_ex_mapped(int addr, int size, long data) const;
+
   // Nametable and CHR RAM
   static const uint16_t nt_ram_size = 0x1000;
   static const uint16_t chr_addr_size = 0x2000;
@@ -113,6 +121,10 @@ class Ppu_Impl : public ppu_state_t
   uint8_t spr_ram[spr_ram_size];
   void all_tiles_modified();
 
+  // Replaces the contents of CHR RAM, marking only the tiles whose data actually changed as
+  // modified, so that loading a state leaves the tile cache untouched when CHR RAM did not change.
+  void load_chr_ram(uint8_t const *);
+
   protected:
   void begin_frame();
   void run_hblank(int);
@@ -122,10 +134,18 @@ class Ppu_Impl : public ppu_state_t
   int addr_inc; // pre-calculated $2007 increment (based on w2001 & 0x04)
   int read_2007(int addr);
 
-  static const uint16_t last_sprite_max_scanline = 240;
   long recalc_sprite_max(int scanline);
   int first_opaque_sprite_line();
 
+  // Sprites in range of each scanline's sprite evaluation, one bit per OAM entry; sprites found
+  // on scanline n are drawn on scanline n + 1. Rebuilt only when sprite Y positions or the sprite
+  // height differ from those the table was built from.
+  uint64_t const *sprite_rows()
+  {
+    if (sprite_rows_stale()) build_sprite_rows();
+    return sprite_rows_;
+  }
+
   protected: // friend class Ppu_Rendering; private:
   unsigned long palette_offset;
   int palette_changed;
@@ -134,6 +154,9 @@ class Ppu_Impl : public ppu_state_t
   bool any_tiles_modified;
   void update_tiles(int first_tile);
 
+  // MMC2/MMC4 latches switch CHR banks as tiles are fetched, so fetches can't be skipped
+  bool chr_latches_enabled() const { return mmc24_enabled; }
+
   typedef uint32_t cache_t;
   typedef cache_t cached_tile_t[4];
   cached_tile_t const &get_bg_tile(int index);
@@ -148,6 +171,7 @@ class Ppu_Impl : public ppu_state_t
   static const uint16_t chr_page_size = 0x400;
   long chr_pages[chr_addr_size / chr_page_size];
   long chr_pages_ex[chr_addr_size / chr_page_size];
+  bool chr_pages_mapped(long const *pages, int addr, int size, long data) const;
   long map_chr_addr(unsigned a) /*const*/
   {
     if (!mmc24_enabled)
@@ -172,6 +196,14 @@ class Ppu_Impl : public ppu_state_t
   bool mmc24_enabled;
   uint8_t mmc24_latched[2];
 
+  // Sprite evaluation
+  bool sprite_rows_stale();
+  void build_sprite_rows();
+  uint64_t sprite_rows_[image_height];
+  uint8_t sprite_rows_top[spr_ram_size / 4]; // Y position of each sprite when last built
+  int sprite_rows_height;                     // zero until first built
+  int first_crowded_row;                      // first row with 8 or more sprites in range
+
   // CHR data
   uint8_t const *chr_data; // points to chr ram when there is no read-only data
   uint8_t *chr_ram;        // always points to impl->chr_ram; makes write_2007() faster
@@ -180,7 +212,8 @@ class Ppu_Impl : public ppu_state_t
   // CHR cache
   cached_tile_t *tile_cache;
   cached_tile_t *flipped_tiles;
-  uint8_t *tile_cache_mem;
+  uint8_t *tile_cache_mem; // allocated for CHR RAM only
+  Tile_Cache *rom_tiles;   // cartridge's cache when CHR is read-only
   union
   {
     uint8_t modified_tiles[chr_tile_count / 8];
@@ -199,6 +232,13 @@ inline void Ppu_Impl::set_nt_banks(int bank0, int bank1, int bank2, int bank3)
   nt_banks[3] = &nt_ram[bank3 * 0x400];
 }
 
+inline bool Ppu_Impl::nt_banks_mapped(int bank0, int bank1, int bank2, int bank3) const
+{
+  uint8_t *nt_ram = impl->nt_ram;
+  return nt_banks[0] == &nt_ram[bank0 * 0x400] && nt_banks[1] == &nt_ram[bank1 * 0x400] &&
+         nt_banks[2] == &nt_ram[bank2 * 0x400] && nt_banks[3] == &nt_ram[bank3 * 0x400];
+}
+
 inline int Ppu_Impl::map_palette(int addr)
 {
   if ((addr & 3) == 0)
@@ -4,6 +4,12 @@
 #include <stddef.h>
 #include <string.h>
 #include <algorithm>
+#include <bit>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+  #define NES_PPU_X86_SIMD 1
+  #include <immintrin.h>
+#endif
 
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -122,6 +128,130 @@ void Ppu_Rendering::restore_left(int count)
 
 // Background
 
+#ifdef NES_PPU_X86_SIMD
+
+// Vectorised tile drawing. Each cached tile line holds two rows of 2-bit pixels; a group of tiles
+// is transposed so that one register holds the same line of every tile, then each row is expanded
+// and interleaved into contiguous pixels. Same output as the scalar loop in draw_background_().
+
+static inline void draw_tile(uint8_t *p, long row_bytes, uint32_t const *lines, uint32_t offset)
+{
+  uint32_t const mask = 0x03030303;
+  for (int n = 4; n--;)
+  {
+    uint32_t line = *lines++;
+    ((uint32_t *)p)[0] = (line >> 4 & mask) + offset;
+    ((uint32_t *)p)[1] = (line & mask) + offset;
+    p += row_bytes;
+    ((uint32_t *)p)[0] = (line >> 6 & mask) + offset;
+    ((uint32_t *)p)[1] = (line >> 2 & mask) + offset;
+    p += row_bytes;
+  }
+}
+
+static inline void draw_row_sse2(uint8_t *p, __m128i line, int left_shift, int right_shift, __m128i mask, __m128i offset_lo, __m128i offset_hi)
+{
+  __m128i left = _mm_and_si128(_mm_srli_epi32(line, left_shift), mask);
+  __m128i right = _mm_and_si128(_mm_srli_epi32(line, right_shift), mask);
+  _mm_storeu_si128((__m128i *)p, _mm_add_epi32(_mm_unpacklo_epi32(left, right), offset_lo));
+  _mm_storeu_si128((__m128i *)(p + 16), _mm_add_epi32(_mm_unpackhi_epi32(left, right), offset_hi));
+}
+
+// 4 tiles (32 pixels per row) per iteration
+static void draw_tiles_sse2(uint8_t *pixels, long row_bytes, uint32_t const *const *tiles, uint32_t const *offsets, int count)
+{
+  __m128i const mask = _mm_set1_epi32(0x03030303);
+  for (; count >= 4; count -= 4)
+  {
+    __m128i t0 = _mm_loadu_si128((__m128i const *)tiles[0]);
+    __m128i t1 = _mm_loadu_si128((__m128i const *)tiles[1]);
+    __m128i t2 = _mm_loadu_si128((__m128i const *)tiles[2]);
+    __m128i t3 = _mm_loadu_si128((__m128i const *)tiles[3]);
+    __m128i u0 = _mm_unpacklo_epi32(t0, t1);
+    __m128i u1 = _mm_unpacklo_epi32(t2, t3);
+    __m128i u2 = _mm_unpackhi_epi32(t0, t1);
+    __m128i u3 = _mm_unpackhi_epi32(t2, t3);
+    __m128i lines[4] = {_mm_unpacklo_epi64(u0, u1), _mm_unpackhi_epi64(u0, u1), _mm_unpacklo_epi64(u2, u3), _mm_unpackhi_epi64(u2, u3)};
+
+    __m128i offset = _mm_loadu_si128((__m128i const *)offsets);
+    __m128i offset_lo = _mm_unpacklo_epi32(offset, offset);
+    __m128i offset_hi = _mm_unpackhi_epi32(offset, offset);
+
+    uint8_t *p = pixels;
+    for (int n = 0; n < 4; n++)
+    {
+      draw_row_sse2(p, lines[n], 4, 0, mask, offset_lo, offset_hi);
+      p += row_bytes;
+      draw_row_sse2(p, lines[n], 6, 2, mask, offset_lo, offset_hi);
+      p += row_bytes;
+    }
+
+    tiles += 4;
+    offsets += 4;
+    pixels += 32;
+  }
+
+  for (; count--; pixels += 8) draw_tile(pixels, row_bytes, *tiles++, *offsets++);
+}
+
+__attribute__((target("avx2"))) static inline void draw_row_avx2(uint8_t *p, __m256i line, int left_shift, int right_shift, __m256i mask, __m256i offset_lo, __m256i offset_hi)
+{
+  __m256i left = _mm256_and_si256(_mm256_srli_epi32(line, left_shift), mask);
+  __m256i right = _mm256_and_si256(_mm256_srli_epi32(line, right_shift), mask);
+  __m256i lo = _mm256_add_epi32(_mm256_unpacklo_epi32(left, right), offset_lo); // tiles 0 1 | 4 5
+  __m256i hi = _mm256_add_epi32(_mm256_unpackhi_epi32(left, right), offset_hi); // tiles 2 3 | 6 7
+  _mm256_storeu_si256((__m256i *)p, _mm256_permute2x128_si256(lo, hi, 0x20));
+  _mm256_storeu_si256((__m256i *)(p + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+// 8 tiles (64 pixels per row) per iteration, tiles 0-3 in the low and 4-7 in the high 128 bits
+__attribute__((target("avx2"))) static void draw_tiles_avx2(uint8_t *pixels, long row_bytes, uint32_t const *const *tiles, uint32_t const *offsets, int count)
+{
+  __m256i const mask = _mm256_set1_epi32(0x03030303);
+  for (; count >= 8; count -= 8)
+  {
+    __m256i t0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)tiles[0])), _mm_loadu_si128((__m128i const *)tiles[4]), 1);
+    __m256i t1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)tiles[1])), _mm_loadu_si128((__m128i const *)tiles[5]), 1);
+    __m256i t2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)tiles[2])), _mm_loadu_si128((__m128i const *)tiles[6]), 1);
+    __m256i t3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)tiles[3])), _mm_loadu_si128((__m128i const *)tiles[7]), 1);
+    __m256i u0 = _mm256_unpacklo_epi32(t0, t1);
+    __m256i u1 = _mm256_unpacklo_epi32(t2, t3);
+    __m256i u2 = _mm256_unpackhi_epi32(t0, t1);
+    __m256i u3 = _mm256_unpackhi_epi32(t2, t3);
+    __m256i lines[4] = {_mm256_unpacklo_epi64(u0, u1), _mm256_unpackhi_epi64(u0, u1), _mm256_unpacklo_epi64(u2, u3), _mm256_unpackhi_epi64(u2, u3)};
+
+    __m256i offset = _mm256_loadu_si256((__m256i const *)offsets);
+    __m256i offset_lo = _mm256_unpacklo_epi32(offset, offset);
+    __m256i offset_hi = _mm256_unpackhi_epi32(offset, offset);
+
+    uint8_t *p = pixels;
+    for (int n = 0; n < 4; n++)
+    {
+      draw_row_avx2(p, lines[n], 4, 0, mask, offset_lo, offset_hi);
+      p += row_bytes;
+      draw_row_avx2(p, lines[n], 6, 2, mask, offset_lo, offset_hi);
+      p += row_bytes;
+    }
+
+    tiles += 8;
+    offsets += 8;
+    pixels += 64;
+  }
+
+  draw_tiles_sse2(pixels, row_bytes, tiles, offsets, count);
+}
+
+#endif
+
+void Ppu_Rendering::set_simd_rendering(bool enabled)
+{
+  draw_tiles = nullptr;
+#ifdef NES_PPU_X86_SIMD
+  if (enabled)
+    draw_tiles = __builtin_cpu_supports("avx2") ? draw_tiles_avx2 : draw_tiles_sse2;
+#endif
+}
+
 void Ppu_Rendering::draw_background_(int remain)
 {
   // Draws 'remain' background scanlines. Does not modify vram_addr.
@@ -183,6 +313,12 @@ void Ppu_Rendering::draw_background_(int remain)
     addr &= 0x03ff;
     if (height == 8) height -= fine_y & 1;
 
+    // full rows of tiles are gathered and drawn together by the vectorised version, if any
+    cache_t const *tiles[33];
+    uint32_t offsets[33];
+    int tile_count = 0;
+    uint8_t *const first_pixels = pixels;
+
     while (true)
     {
       while (count--)
@@ -197,7 +333,13 @@ void Ppu_Rendering::draw_background_(int remain)
         addr++;
         pixels += 8; // next tile
 
-        if (!clipped)
+        if (!clipped && draw_tiles)
+        {
+          tiles[tile_count] = lines;
+          offsets[tile_count] = offset;
+          tile_count++;
+        }
+        else if (!clipped)
         {
           // optimal case: no clipping
           for (int n = 4; n--;)
@@ -252,6 +394,9 @@ void Ppu_Rendering::draw_background_(int remain)
         break;
     }
 
+    if (tile_count)
+      draw_tiles(first_pixels, row_bytes, tiles, offsets, tile_count);
+
   } while (remain);
 }
 
@@ -264,11 +409,17 @@ void Ppu_Rendering::draw_sprites_(int begin, int end)
   int const sprite_height = this->sprite_height();
   int end_minus_one = end - 1;
   int begin_minus_one = begin - 1;
-  int index = 0;
-  do
+
+  // only visit sprites in range of the scanlines, in OAM order
+  uint64_t const *rows = sprite_rows();
+  uint64_t in_range = 0;
+  for (int row = std::max(begin_minus_one, 0); row < end_minus_one; row++)
+    in_range |= rows[row];
+
+  while (in_range)
   {
-    uint8_t const *sprite = &spr_ram[index];
-    index += 4;
+    uint8_t const *sprite = &spr_ram[std::countr_zero(in_range) * 4];
+    in_range &= in_range - 1;
 
     // find if sprite is visible
     int top_minus_one = sprite[0];
@@ -308,7 +459,7 @@ void Ppu_Rendering::draw_sprites_(int begin, int end)
 #define CLIPPED 1
 #include "ppuSprites.hpp"
     }
-  } while (index < 0x100);
+  }
 }
 
 void Ppu_Rendering::check_sprite_hit(int begin, int end)
@@ -404,6 +555,91 @@ void Ppu_Rendering::check_sprite_hit(int begin, int end)
   } while (skip != final);
 }
 
+void Ppu_Rendering::check_sprite_hit_headless(int begin, int count)
+{
+  // Same as drawing 'count' background scanlines from 'begin' into the mini offscreen buffer and
+  // checking them for sprite 0 hit, but only the eight background pixels under sprite 0 are
+  // produced for each scanline, straight from the tile cache. Does not modify vram_addr.
+
+  if (any_tiles_modified && chr_is_writable)
+  {
+    any_tiles_modified = false;
+    update_tiles(0);
+  }
+
+  uint32_t rows[mini_offscreen_height * 2]; // background under the sprite, one 8-pixel row per scanline
+  int const left_clip = (w2001 >> 1 & 1) ^ 1;
+  int const bg_bank = (w2000 << 4) & 0x100;
+  unsigned long const mask = 0x03030303 + zero;
+
+  // Tiles are laid out from -pixel_x, so the sprite covers (part of) two tiles
+  int const first_tile = (spr_ram[3] + pixel_x) >> 3;
+  int const tile_offset = (spr_ram[3] + pixel_x) & 7;
+
+  int vram_addr = this->vram_addr & 0x7fff;
+  int row = 0;
+  int remain = count;
+  do
+  {
+    // rows are stepped exactly as in draw_background_()
+    int height = 8 - (vram_addr >> 12);
+    if (height > remain)
+      height = remain;
+
+    int hscroll_changed = (vram_addr ^ vram_temp) & 0x41f;
+    int addr = vram_addr;
+    if (hscroll_changed)
+    {
+      vram_addr ^= hscroll_changed;
+      height = 1;
+    }
+    remain -= height;
+
+    vram_addr += height << 12;
+    if (vram_addr & 0x8000)
+    {
+      int y = (vram_addr + 0x20) & 0x3e0;
+      vram_addr &= 0x7fff & ~0x3e0;
+      if (y == 30 * 0x20)
+        y = 0x800;
+      vram_addr ^= y;
+    }
+
+    uint8_t const *nametable = get_nametable(addr);
+    uint8_t const *nametable2 = get_nametable(addr ^ 0x400);
+    int const fine_y = addr >> 12;
+
+    for (int n = 0; n < height; n++, row++)
+    {
+      uint32_t pixels[4];
+      for (int i = 0; i < 2; i++)
+      {
+        // tiles left of the clip and past the 33rd one aren't drawn
+        int const tile = first_tile + i;
+        pixels[i * 2] = 0;
+        pixels[i * 2 + 1] = 0;
+        if (tile < left_clip || tile > 32)
+          continue;
+
+        int const x = (addr & 31) + tile;
+        uint8_t const *tiles = x < 32 ? nametable : nametable2;
+        int const tile_y = fine_y + n;
+        unsigned long line = this->get_bg_tile(tiles[(addr & 0x3e0) | (x & 31)] + bg_bank)[tile_y >> 1];
+        line >>= (tile_y & 1) << 1;
+        pixels[i * 2] = line >> 4 & mask;
+        pixels[i * 2 + 1] = line & mask;
+      }
+      memcpy(&rows[row * 2], (uint8_t *)pixels + tile_offset, 8);
+    }
+  } while (remain);
+
+  // rows are laid out so that check_sprite_hit() finds them where it expects the scanlines
+  scanline_pixels = (uint8_t *)rows - spr_ram[3];
+  scanline_row_bytes = 8;
+  check_sprite_hit(begin, begin + count);
+  scanline_pixels = NULL;
+}
+
 // Draw scanlines
 
 inline bool Ppu_Rendering::sprite_hit_possible(int scanline) const
@@ -411,28 +647,28 @@ inline bool Ppu_Rendering::sprite_hit_possible(int scanline) const
   return !sprite_hit_found && spr_ram[0] <= scanline && (w2001 & 0x18) == 0x18;
 }
 
-void Ppu_Rendering::draw_scanlines(int start, int count, uint8_t *pixels, long pitch, int mode)
+template <int mode, int w2001_bits>
+void Ppu_Rendering::draw_scanlines_(int start, int count, uint8_t *pixels, long pitch)
 {
   scanline_pixels = pixels + image_left;
   scanline_row_bytes = pitch;
 
   int const obj_mask = 2;
   int const bg_mask = 1;
-  int draw_mode = (w2001 >> 3) & 3;
-  int clip_mode = (~w2001 >> 1) & draw_mode;
+  int const enabled = (w2001_bits >> 2) & 3;
+  int const draw_mode = enabled & mode;
 
-  if (!(draw_mode & bg_mask))
-  {
-    // no background
-    clip_mode |= bg_mask; // avoid unnecessary save/restore
-    if (mode & bg_mask)
-      fill_background(count);
-  }
+  // without background, bg_mask avoids unnecessary save/restore
+  int const clip_mode = (~w2001_bits & enabled) | (enabled & bg_mask ? 0 : bg_mask);
 
-  if (start == 0 && mode & 1)
-    memset(sprite_scanlines, max_sprites - sprite_limit, 240);
+  if constexpr (!(enabled & bg_mask) && (mode & bg_mask))
+    fill_background(count); // no background
+
+  if constexpr ((mode & bg_mask) != 0)
+    if (start == 0)
+      memset(sprite_scanlines, max_sprites - sprite_limit, 240);
 
-  if ((draw_mode &= mode))
+  if constexpr (draw_mode != 0)
   {
     // sprites and/or background are being rendered
 
@@ -442,32 +678,32 @@ void Ppu_Rendering::draw_scanlines(int start, int count, uint8_t *pixels, long p
       update_tiles(0);
     }
 
-    if (draw_mode & bg_mask)
+    if constexpr ((draw_mode & bg_mask) != 0)
     {
       // dprintf( "bg  %3d-%3d\n", start, start + count - 1 );
       draw_background_(count);
 
-      if (clip_mode == bg_mask)
+      if constexpr (clip_mode == bg_mask)
         clip_left(count);
 
       if (sprite_hit_possible(start + count))
         check_sprite_hit(start, start + count);
     }
 
-    if (draw_mode & obj_mask)
+    if constexpr ((draw_mode & obj_mask) != 0)
     {
       // when clipping just sprites, save left strip then restore after drawing them
-      if (clip_mode == obj_mask)
+      if constexpr (clip_mode == obj_mask)
         save_left(count);
 
       // dprintf( "obj %3d-%3d\n", start, start + count - 1 );
 
       draw_sprites_(start, start + count);
 
-      if (clip_mode == obj_mask)
+      if constexpr (clip_mode == obj_mask)
         restore_left(count);
 
-      if (clip_mode == (obj_mask | bg_mask))
+      if constexpr (clip_mode == (obj_mask | bg_mask))
         clip_left(count);
     }
   }
@@ -475,6 +711,164 @@ void Ppu_Rendering::draw_scanlines(int start, int count, uint8_t *pixels, long p
   scanline_pixels = NULL;
 }
 
+template <int mode>
+void Ppu_Rendering::draw_scanlines(int start, int count, uint8_t *pixels, long pitch)
+{
+  // indexed by w2001 bits 1-4: left background, left sprites, background and sprites shown
+  typedef void (Ppu_Rendering::*draw_func_t)(int, int, uint8_t *, long);
+  static draw_func_t const funcs[16] = {
+    &Ppu_Rendering::draw_scanlines_<mode, 0>, &Ppu_Rendering::draw_scanlines_<mode, 1>,
+    &Ppu_Rendering::draw_scanlines_<mode, 2>, &Ppu_Rendering::draw_scanlines_<mode, 3>,
+    &Ppu_Rendering::draw_scanlines_<mode, 4>, &Ppu_Rendering::draw_scanlines_<mode, 5>,
+    &Ppu_Rendering::draw_scanlines_<mode, 6>, &Ppu_Rendering::draw_scanlines_<mode, 7>,
+    &Ppu_Rendering::draw_scanlines_<mode, 8>, &Ppu_Rendering::draw_scanlines_<mode, 9>,
+    &Ppu_Rendering::draw_scanlines_<mode, 10>, &Ppu_Rendering::draw_scanlines_<mode, 11>,
+    &Ppu_Rendering::draw_scanlines_<mode, 12>, &Ppu_Rendering::draw_scanlines_<mode, 13>,
+    &Ppu_Rendering::draw_scanlines_<mode, 14>, &Ppu_Rendering::draw_scanlines_<mode, 15>};
+  (this->*funcs[(w2001 >> 1) & 15])(start, count, pixels, pitch);
+}
+
+void Ppu_Rendering::draw_sprites(int start, int count)
+{
+  draw_scanlines<2>(start, count, host_pixels + host_row_bytes * start, host_row_bytes);
+}
+
+void Ppu_Rendering::convert_scanlines(int start, int count)
+{
+  // scanlines are complete once their sprites are drawn; they are converted while still in cache
+  count = std::min(count, image_height - start);
+  uint8_t const *in = host_pixels + host_row_bytes * start + image_left;
+  uint8_t *out = (uint8_t *)host_pixels32 + host_row_bytes32 * start;
+  uint32_t const *colors = host_colors;
+
+  for (int n = count; n > 0; n--)
+  {
+    uint32_t *pixels = (uint32_t *)out;
+    for (int x = 0; x < image_width; x += 4)
+    {
+      pixels[x] = colors[in[x]];
+      pixels[x + 1] = colors[in[x + 1]];
+      pixels[x + 2] = colors[in[x + 2]];
+      pixels[x + 3] = colors[in[x + 3]];
+    }
+    in += host_row_bytes;
+    out += host_row_bytes32;
+  }
+}
+
+const char *Ppu_Rendering::set_observation(uint8_t *pixels, long row_bytes, observation_t const *obs)
+{
+  obs_pixels = NULL;
+  if (!obs)
+    return 0;
+
+  if (obs->left < 0 || obs->top < 0 || obs->width <= 0 || obs->height <= 0 ||
+      obs->left + obs->width > image_width || obs->top + obs->height > image_height)
+    return "Observation crop is outside of the image";
+  if (obs->out_width <= 0 || obs->out_height <= 0 || obs->out_width > obs->width || obs->out_height > obs->height)
+    return "Observation is larger than its crop";
+
+  // pixel centers; the box filter adds the next column and scanline within the crop
+  for (int x = 0; x < obs->out_width; x++)
+  {
+    int sx = obs->left + (2 * x + 1) * obs->width / (2 * obs->out_width);
+    obs_x[x][0] = sx;
+    obs_x[x][1] = obs->box_filter ? std::min(sx + 1, obs->left + obs->width - 1) : sx;
+  }
+
+  memset(obs_scanlines, 0, sizeof obs_scanlines);
+  for (int y = 0; y < obs->out_height; y++)
+  {
+    int sy = obs->top + (2 * y + 1) * obs->height / (2 * obs->out_height);
+    obs_y[y][0] = sy;
+    obs_y[y][1] = obs->box_filter ? std::min(sy + 1, obs->top + obs->height - 1) : sy;
+    obs_scanlines[obs_y[y][0]] = true;
+    obs_scanlines[obs_y[y][1]] = true;
+  }
+
+  // a lone scanline costs about as much to draw as a row of tiles, so only gaps of a row or more
+  // between sampled scanlines are left out
+  for (int y = obs_y[0][0], last = y; y <= obs_y[obs->out_height - 1][1]; y++)
+  {
+    if (!obs_scanlines[y])
+      continue;
+    if (y - last < 8)
+      memset(&obs_scanlines[last], true, y - last);
+    last = y;
+  }
+
+  obs_pixels = pixels;
+  obs_row_bytes = row_bytes;
+  obs_width = obs->out_width;
+  obs_height = obs->out_height;
+  obs_box = obs->box_filter;
+  return 0;
+}
+
+void Ppu_Rendering::sample_observation(int end)
+{
+  // observation rows are sampled once all of their scanlines are complete
+  uint32_t const *colors = host_colors;
+  for (; next_observation_row < obs_height && obs_y[next_observation_row][1] < end; next_observation_row++)
+  {
+    int const y = next_observation_row;
+    uint8_t const *in0 = host_pixels + host_row_bytes * obs_y[y][0] + image_left;
+    uint8_t const *in1 = host_pixels + host_row_bytes * obs_y[y][1] + image_left;
+    uint8_t *out = obs_pixels + obs_row_bytes * y;
+
+    if (obs_box)
+    {
+      for (int x = 0; x < obs_width; x++)
+      {
+        int const x0 = obs_x[x][0];
+        int const x1 = obs_x[x][1];
+        out[x] = (colors[in0[x0]] + colors[in0[x1]] + colors[in1[x0]] + colors[in1[x1]] + 2) >> 2;
+      }
+    }
+    else
+    {
+      for (int x = 0; x < obs_width; x++)
+        out[x] = colors[in0[obs_x[x][0]]];
+    }
+  }
+}
+
+void Ppu_Rendering::draw_observed(int start, int count)
+{
+  // Only scanlines used by the observation are drawn. Sprite 0 hit is checked on the whole
+  // band as drawn, so bands where it can still occur are drawn entirely.
+  int const end = start + count;
+  if (sprite_hit_possible(end) && spr_ram[0] + 1 < end)
+  {
+    draw_scanlines<1>(start, count, host_pixels + host_row_bytes * start, host_row_bytes);
+    return;
+  }
+
+  if (start == 0)
+    memset(sprite_scanlines, max_sprites - sprite_limit, 240);
+
+  int const saved_vaddr = vram_addr;
+  for (int begin = start; begin < end;)
+  {
+    bool const drawn = obs_scanlines[begin];
+    int next = begin + 1;
+    while (next < end && obs_scanlines[next] == drawn)
+      next++;
+
+    if (drawn)
+    {
+      // rows are stepped to the first scanline of the run as drawing would have
+      vram_addr = saved_vaddr;
+      if (begin > start)
+        run_hblank(begin - start);
+      draw_scanlines<1>(begin, next - begin, host_pixels + host_row_bytes * begin, host_row_bytes);
+    }
+
+    begin = next;
+  }
+  vram_addr = saved_vaddr;
+}
+
 void Ppu_Rendering::draw_background(int start, int count)
 {
   // always capture palette at least once per frame
@@ -486,7 +880,11 @@ void Ppu_Rendering::draw_background(int start, int count)
 
   if (host_pixels)
   {
-    draw_scanlines(start, count, host_pixels + host_row_bytes * start, host_row_bytes, 1);
+    // MMC2/MMC4 latches depend on every tile fetched, so all scanlines are drawn for them
+    if (obs_pixels && !chr_latches_enabled())
+      draw_observed(start, count);
+    else
+      draw_scanlines<1>(start, count, host_pixels + host_row_bytes * start, host_row_bytes);
   }
   else if (sprite_hit_possible(start + count))
   {
@@ -498,7 +896,10 @@ void Ppu_Rendering::draw_background(int start, int count)
     if (visible > 0)
     {
       run_hblank(skip);
-      draw_scanlines(start + skip, visible, impl->mini_offscreen, buffer_width, 3);
+      if (chr_latches_enabled())
+        draw_scanlines<3>(start + skip, visible, impl->mini_offscreen, buffer_width);
+      else
+        check_sprite_hit_headless(start + skip, visible);
     }
   }
 }
@@ -20,14 +20,56 @@ class Ppu_Rendering : public Ppu_Impl
   uint8_t *host_pixels;
   long host_row_bytes;
 
+  // 32-bit output: completed scanlines of host_pixels are converted here through host_colors
+  uint32_t *host_pixels32;
+  long host_row_bytes32;
+
+  // Observation output: completed scanlines are sampled into a cropped and scaled down image of
+  // one byte per pixel, looked up through host_colors. Scanlines it never samples aren't drawn.
+  struct observation_t
+  {
+    int left, top, width, height; // crop rectangle within the image
+    int out_width, out_height;    // size of the observation, at most the size of the crop
+    bool box_filter;              // average 2x2 pixels instead of taking the nearest one
+  };
+  const char *set_observation(uint8_t *pixels, long row_bytes, observation_t const *); // null disables it
+
+  // Background tiles are drawn with SSE2 or AVX2 when the host CPU supports them. Disabling it
+  // falls back to the scalar code, which produces the same pixels.
+  void set_simd_rendering(bool enabled);
+  bool simd_rendering() const { return draw_tiles != nullptr; }
+
   protected:
   long sprite_hit_found; // -1: sprite 0 didn't hit, 0: no hit so far, > 0: y * 341 + x
   void draw_background(int start, int count);
   void draw_sprites(int start, int count);
+  void convert_scanlines(int start, int count);
+  uint8_t *obs_pixels;
+  int next_observation_row;
+  void sample_observation(int end);
 
   private:
-  void draw_scanlines(int start, int count, uint8_t *pixels, long pitch, int mode);
+  // Draws the background (mode 1), sprites (2) or both (3) with a variant specialized for the mode
+  // and for the enable and left clipping bits of w2001, picked from a table on each call.
+  template <int mode>
+  void draw_scanlines(int start, int count, uint8_t *pixels, long pitch);
+  template <int mode, int w2001_bits>
+  void draw_scanlines_(int start, int count, uint8_t *pixels, long pitch);
   void draw_background_(int count);
+  void draw_observed(int start, int count);
+
+  // observation sampling: source columns and scanlines of each pixel (two of each for the box filter)
+  long obs_row_bytes;
+  int obs_width;
+  int obs_height;
+  bool obs_box;
+  uint8_t obs_x[image_width][2];
+  uint8_t obs_y[image_height][2];
+  bool obs_scanlines[image_height]; // scanlines sampled by the observation
+
+  // draws 'count' full tiles (all 8 rows) side by side; null if no vectorised version is used
+  typedef void (*draw_tiles_t)(uint8_t *pixels, long row_bytes, cache_t const *const *tiles, uint32_t const *offsets, int count);
+  draw_tiles_t draw_tiles;
 
   // destination for draw functions; avoids extra parameters
   uint8_t *scanline_pixels;
@@ -48,17 +90,17 @@ class Ppu_Rendering : public Ppu_Impl
   void draw_sprites_(int start, int count);
   bool sprite_hit_possible(int scanline) const;
   void check_sprite_hit(int begin, int end);
+  void check_sprite_hit_headless(int begin, int count);
 };
 
 inline Ppu_Rendering::Ppu_Rendering()
 {
   sprite_limit = 8;
   host_pixels = nullptr;
-}
-
-inline void Ppu_Rendering::draw_sprites(int start, int count)
-{
-  draw_scanlines(start, count, host_pixels + host_row_bytes * start, host_row_bytes, 2);
+  host_pixels32 = nullptr;
+  obs_pixels = nullptr;
+  next_observation_row = 0;
+  set_simd_rendering(true);
 }
 
 } // namespace quickerNES
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+// Decoded CHR ROM tiles, shared by every emulator using a cartridge
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace quickerNES
+{
+
+// The PPU draws from a cache holding each CHR tile reordered for its blitters, plus a horizontally
+// flipped copy, at the same offsets as the CHR data. For CHR ROM the cache never changes, so the
+// cartridge owns a single one for all its emulators. Tiles are decoded a 1 KB bank at a time, the
+// first time a PPU maps the bank; emulators on different threads may do so concurrently.
+class Tile_Cache
+{
+  public:
+  static const uint16_t bank_size = 0x400;
+  static const uint8_t bytes_per_tile = 16;
+
+  Tile_Cache() = default;
+  ~Tile_Cache() { free(mem); }
+
+  // noncopyable
+  Tile_Cache(const Tile_Cache &) = delete;
+  Tile_Cache &operator=(const Tile_Cache &) = delete;
+
+  // Makes room for decoding size bytes of CHR data. Nothing gets decoded yet.
+  const char *init(uint8_t const *chr, long size);
+
+  // Decodes the banks covering size bytes at offset, unless done already
+  void require(long offset, long size)
+  {
+    long end = (offset + size + bank_size - 1) / bank_size;
+    if (end > bank_count) end = bank_count;
+    for (long bank = offset / bank_size; bank < end; bank++)
+      if (!built[bank].load(std::memory_order_acquire)) build(bank);
+  }
+
+  // Decodes the tiles covering [begin, end) again after the CHR data changed
+  void rebuild(unsigned long begin, unsigned long end);
+
+  // Normal and flipped tiles, addressed by CHR offset
+  uint8_t *tiles() const { return tiles_; }
+  uint8_t *flipped_tiles() const { return tiles_ + size_; }
+
+  // Decodes one tile, 16 bytes of CHR data, into its normal and flipped cache entries
+  static void decode(uint8_t const *in, uint8_t *out, uint8_t *flipped_out);
+
+  private:
+  void build(long bank);
+
+  uint8_t const *chr = nullptr;
+  long size_ = 0;
+  long bank_count = 0;
+  uint8_t *mem = nullptr;
+  uint8_t *tiles_ = nullptr;
+  std::unique_ptr<std::atomic<bool>[]> built;
+  std::mutex mutex;
+};
+
+} // namespace quickerNES
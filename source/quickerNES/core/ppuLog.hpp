@@ -0,0 +1,63 @@
+#pragma once
+
+// Log of the PPU-visible events of a frame
+
+#include "cpu.hpp"
+#include <stdint.h>
+#include <vector>
+
+namespace quickerNES
+{
+
+// Everything that changes what the PPU draws, as seen from outside of it: register writes, register
+// reads with side effects, sprite DMA, and the mapper's CHR bank and nametable changes, each with
+// the time it happened at. Another emulator holding the same state at the start of the frame can
+// replay these events (Core::replay_frame) to produce the frame's image without running the CPU,
+// APU or mapper. Storage is kept between frames, so logging only allocates while it grows.
+struct ppu_log_t
+{
+  enum event_kind_t
+  {
+    reg_write,   // CPU write to $2000-$3FFF
+    reg_read,    // CPU read of $2000-$3FFF, other than the inlined $2002 reads
+    status_read, // inlined $2002 read; data tells if the PPU had to be caught up for it
+    sprite_dma,  // $4014 write; value is the offset of the 256 bytes in sprite_data
+    chr_bank,    // Mapper::set_chr_bank; data is log2 of the size, value the CHR offset
+    chr_bank_ex, // Mapper::set_chr_bank_ex; same as chr_bank
+    nt_banks,    // Mapper::mirror_manual; value holds the four pages, one per byte
+    bg_catch_up  // background catch-up at the end of the frame
+  };
+
+  struct event_t
+  {
+    int32_t time;
+    uint8_t kind;
+    uint8_t data;
+    uint16_t addr;
+    int32_t value;
+  };
+
+  std::vector<event_t> events;
+  std::vector<uint8_t> sprite_data;
+  nes_time_t frame_length = 0; // CPU time the frame ended at; zero while it is in progress
+
+  void clear()
+  {
+    events.clear();
+    sprite_data.clear();
+    frame_length = 0;
+  }
+
+  void add(event_kind_t kind, nes_time_t time, unsigned addr, int data, int32_t value = 0)
+  {
+    events.push_back(event_t{(int32_t)time, (uint8_t)kind, (uint8_t)data, (uint16_t)addr, value});
+  }
+
+  void add_sprite_dma(nes_time_t time, uint8_t const *in)
+  {
+    add(sprite_dma, time, 0x4014, 0, (int32_t)sprite_data.size());
+    sprite_data.insert(sprite_data.end(), in, in + 0x100);
+  }
+};
+
+} // namespace quickerNES
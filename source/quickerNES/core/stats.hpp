@@ -0,0 +1,36 @@
+#pragma once
+
+// Per-frame emulation statistics
+
+#include <stdint.h>
+
+namespace quickerNES
+{
+
+// Cheap counters describing the work done while emulating the current frame. They are only kept
+// when built with _QUICKERNES_ENABLE_STATS; otherwise every counting statement compiles to nothing.
+struct frame_stats_t
+{
+  uint64_t cpu_instructions; // instructions executed by the CPU core
+  uint64_t cpu_cycles;       // CPU cycles executed by the CPU core
+  uint64_t cpu_runs;         // calls to Cpu::run
+  uint64_t cpu_results[4];   // calls to Cpu::run by the reason they returned (Cpu::result_t)
+  uint64_t ppu_bg_renders;   // background catch-ups (Ppu::render_bg_until_)
+  uint64_t ppu_sprite_hits;  // sprite 0 hit catch-ups (Ppu::update_sprite_hit)
+  uint64_t ppu_sprite_max;   // sprite overflow catch-ups (Ppu::run_sprite_max_)
+  uint64_t mapper_writes;    // CPU writes handled by the mapper
+  uint64_t bank_requests;    // PRG, CHR and nametable bank settings made by mappers
+  uint64_t bank_switches;    // bank settings that changed the mapping
+  uint64_t apu_runs;         // APU catch-ups (Apu::run_until and Apu::run_until_)
+  uint64_t dmc_reads;        // DMC sample bytes fetched from memory
+  uint64_t irqs;             // IRQs vectored
+  uint64_t nmis;             // NMIs vectored
+};
+
+#ifdef _QUICKERNES_ENABLE_STATS
+  #define NES_STAT(statement) statement
+#else
+  #define NES_STAT(statement)
+#endif
+
+} // namespace quickerNES
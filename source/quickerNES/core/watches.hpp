@@ -0,0 +1,191 @@
+#pragma once
+
+// Run-until-condition watch table
+
+#include "cpu.hpp"
+#include <stdint.h>
+#include <string.h>
+
+namespace quickerNES
+{
+
+struct watch_t
+{
+  enum type_t
+  {
+    pc_reached,       // PC reaches addr (stops before the instruction executes)
+    ram_written,      // low RAM byte at addr is written, optionally with a given value (stops after the write)
+    scanline_started, // given scanline starts (-1 to 260)
+    cycles_elapsed    // given number of CPU cycles elapsed since the watch was added
+  };
+
+  type_t type;
+  nes_addr_t addr;
+  int value;       // value predicate for ram_written watches, or -1 to match any value
+  int scanline;
+  nes_time_t time; // CPU time at which a timed watch triggers, in the current frame's time base
+  bool armed;      // timed watches trigger once per arming
+};
+
+// Watches get compiled into flat lookups so that the emulation loop does constant work per check.
+// Watches on PC or RAM require the CPU to be stepped one instruction at a time; timed watches only
+// lower the CPU end time.
+class Watch_Table
+{
+  public:
+  enum
+  {
+    max_watches = 16
+  };
+
+  Watch_Table()
+  {
+    clear();
+  }
+
+  // Returns the index of the new watch, or -1 if the table is full
+  int add(const watch_t &w)
+  {
+    if (count == max_watches) return -1;
+    watches[count++] = w;
+    compile();
+    return count - 1;
+  }
+
+  void clear()
+  {
+    count = 0;
+    compile();
+  }
+
+  void compile()
+  {
+    memset(pc_map, 0, sizeof pc_map);
+    ram_count = 0;
+    step = false;
+    for (int i = 0; i < count; i++)
+    {
+      const watch_t &w = watches[i];
+      if (w.type == watch_t::pc_reached)
+      {
+        pc_map[(w.addr & 0xFFFF) >> 3] |= 1 << (w.addr & 7);
+        step = true;
+      }
+      if (w.type == watch_t::ram_written)
+      {
+        ram_index[ram_count++] = i;
+        step = true;
+      }
+    }
+  }
+
+  inline bool pc_watched(nes_addr_t pc) const { return pc_map[pc >> 3] >> (pc & 7) & 1; }
+
+  // Earliest armed timed watch, or 'limit' if there's none before it
+  inline nes_time_t next_timed(nes_time_t limit) const
+  {
+    for (int i = 0; i < count; i++)
+      if (watches[i].armed && (watches[i].type == watch_t::scanline_started || watches[i].type == watch_t::cycles_elapsed) && watches[i].time < limit)
+        limit = watches[i].time;
+    return limit;
+  }
+
+  int count;
+  watch_t watches[max_watches];
+
+  // Compiled lookups
+  bool step;
+  uint8_t pc_map[0x10000 / 8];
+  int ram_count;
+  int ram_index[max_watches];
+
+  // RAM values and write targets captured before each stepped instruction
+  uint8_t ram_before[max_watches];
+  int write_addr[3];
+  int write_count;
+};
+
+// Low RAM addresses (0-0x7FF) the instruction at 'pc' is about to write to, given the current CPU
+// registers. Only instructions that store to memory or push to the stack are decoded; everything
+// else yields zero addresses.
+inline int decode_ram_writes(const Cpu &cpu, int out[3])
+{
+  const Cpu::registers_t &r = cpu.r;
+  const uint8_t *code = cpu.get_code(r.pc);
+  const int opcode = code[0];
+  const int op1 = code[1];
+  const int op16 = code[1] | code[2] << 8;
+  const uint8_t *zp = cpu.low_mem;
+
+  // Stack pushes
+  switch (opcode)
+  {
+  case 0x48: // PHA
+  case 0x08: // PHP
+    out[0] = 0x100 | r.sp;
+    return 1;
+  case 0x20: // JSR
+    out[0] = 0x100 | r.sp;
+    out[1] = 0x100 | uint8_t(r.sp - 1);
+    return 2;
+  case 0x00: // BRK
+    out[0] = 0x100 | r.sp;
+    out[1] = 0x100 | uint8_t(r.sp - 1);
+    out[2] = 0x100 | uint8_t(r.sp - 2);
+    return 3;
+  }
+
+  // Stores, read-modify-write instructions and their unofficial combinations
+  const int group = opcode & 3;
+  const int op = opcode >> 5;
+  const int mode = (opcode >> 2) & 7;
+  bool writes = false;
+  bool use_y = false;
+  if (group == 0) // STY
+    writes = op == 4 && (mode == 1 || mode == 3 || mode == 5);
+  if (group == 1) // STA
+    writes = op == 4 && mode != 2;
+  if (group == 2) // ASL, ROL, LSR, ROR, DEC, INC, STX
+    writes = (op < 4 || op > 5) ? (mode & 1) : (op == 4 && (mode == 1 || mode == 3 || mode == 5));
+  if (group == 3) // SLO, RLA, SRE, RRA, DCP, ISC, SAX
+    writes = (op == 4) ? (mode == 0 || mode == 1 || mode == 3 || mode == 5) : (op != 5 && mode != 2);
+  if (writes == false) return 0;
+
+  // STX/SAX use Y instead of X for their indexed zero page mode
+  if ((group == 2 || group == 3) && op == 4 && mode == 5) use_y = true;
+
+  int addr;
+  switch (mode)
+  {
+  case 0: // (zp,x) for groups 1 and 3
+    {
+      const int ptr = uint8_t(op1 + r.x);
+      addr = zp[ptr] | zp[uint8_t(ptr + 1)] << 8;
+    }
+    break;
+  case 1: // zp
+    addr = op1;
+    break;
+  case 3: // abs
+    addr = op16;
+    break;
+  case 4: // (zp),y
+    addr = uint16_t((zp[op1] | zp[uint8_t(op1 + 1)] << 8) + r.y);
+    break;
+  case 5: // zp,x / zp,y
+    addr = uint8_t(op1 + (use_y ? r.y : r.x));
+    break;
+  case 6: // abs,y
+    addr = uint16_t(op16 + r.y);
+    break;
+  default: // abs,x
+    addr = uint16_t(op16 + r.x);
+    break;
+  }
+
+  if (addr >= 0x2000) return 0;
+  out[0] = addr & 0x7FF;
+  return 1;
+}
+
+} // namespace quickerNES
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "../nesInstanceBase.hpp"
+#include "core/apu/NESEffectsBuffer.hpp"
 #include "core/emu.hpp"
+#include <memory>
 
 typedef quickerNES::Emu emulator_t;
 
@@ -70,6 +72,52 @@ class NESInstance final : public NESInstanceBase
     _nes.usePagedCodeMap();
   }
 
+  bool setSIMDRendering(const bool enabled) override { return _nes.set_simd_rendering(enabled); }
+
+  bool enableAudio(const long sampleRate, const bool effects) override
+  {
+    const char *error;
+    if (effects == false) error = _nes.set_sample_rate(sampleRate);
+    if (effects == true)
+    {
+      if (_effectsBuffer == nullptr) _effectsBuffer = std::make_unique<quickerNES::Nes_Effects_Buffer>();
+      error = _nes.set_sample_rate(sampleRate, _effectsBuffer.get());
+    }
+    if (error != nullptr) return false;
+
+    // The equalizer was set up for the previous sample rate
+    _nes.set_equalizer(_nes.equalizer());
+    return true;
+  }
+
+  size_t readAudioSamples(int16_t *samples, const size_t maxSamples) override { return _nes.read_samples(samples, maxSamples); }
+
+#ifdef _QUICKERNES_ENABLE_STATS
+  void getFrameStats(std::vector<std::pair<const char *, uint64_t>> &stats) const override
+  {
+    const auto &s = _nes.get_frame_stats();
+    stats = {
+      {"CPU Instructions", s.cpu_instructions},
+      {"CPU Cycles", s.cpu_cycles},
+      {"CPU Runs", s.cpu_runs},
+      {"  Stopped: Cycles", s.cpu_results[quickerNES::Cpu::result_cycles]},
+      {"  Stopped: SEI", s.cpu_results[quickerNES::Cpu::result_sei]},
+      {"  Stopped: CLI", s.cpu_results[quickerNES::Cpu::result_cli]},
+      {"  Stopped: Bad Opcode", s.cpu_results[quickerNES::Cpu::result_badop]},
+      {"PPU Background Catch-ups", s.ppu_bg_renders},
+      {"PPU Sprite Hit Catch-ups", s.ppu_sprite_hits},
+      {"PPU Sprite Max Catch-ups", s.ppu_sprite_max},
+      {"Mapper Writes", s.mapper_writes},
+      {"Bank Requests", s.bank_requests},
+      {"Bank Switches", s.bank_switches},
+      {"APU Catch-ups", s.apu_runs},
+      {"DMC Reads", s.dmc_reads},
+      {"IRQs", s.irqs},
+      {"NMIs", s.nmis},
+    };
+  }
+#endif
+
   void advanceState(const jaffar::input_t &input) override
   {
     if (_doRendering == true) _nes.emulate_frame(input.port1, input.port2, input.arkanoidLatch, input.arkanoidFire);
@@ -84,10 +132,21 @@ class NESInstance final : public NESInstanceBase
     return true;
   }
 
+  bool shareROMImpl(NESInstanceBase &source) override
+  {
+    // Emulation only reads the cartridge ROM, and the tile cache it lazily decodes CHR ROM into is
+    // synchronized, so instances on different threads can share it (poke_prg() writes through to it)
+    auto sourceEmulator = (emulator_t *)source.getInternalEmulatorPointer();
+    return _nes.set_cart(sourceEmulator->cart()) == nullptr;
+  }
+
   void enableStateBlockImpl(const std::string &block) override { _nes.enableStateBlock(block); };
   void disableStateBlockImpl(const std::string &block) override { _nes.disableStateBlock(block); };
 
   private:
+  // Stereo sound buffer, attached on request; declared first so that it outlives the emulator using it
+  std::unique_ptr<quickerNES::Nes_Effects_Buffer> _effectsBuffer;
+
   // Emulator instance
   emulator_t _nes;
 };
@@ -0,0 +1,425 @@
+#include "nesInstance.hpp"
+#include "core/apu/apu.hpp"
+#include "core/apu/blipBuffer.hpp"
+#include "core/apu/expansionApu.hpp"
+#include "core/apu/fme7/apu_fme7.hpp"
+#include "core/apu/namco/apu_namco.hpp"
+#include "core/apu/vrc6/apu_vrc6.hpp"
+#include "core/apu/vrc7/apu_vrc7.hpp"
+#include "core/apuLog.hpp"
+#include <argparse/argparse.hpp>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/file.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/string.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Measures the sound chips and Blip_Buffer on their own, replaying traces of register writes without
+// the CPU or PPU. The traces are the apu_log_t of every frame: the APU's is recorded from a test
+// sequence, and so is an expansion chip's if the cartridge has it. The test sequences do not use
+// expansion sound, so the other chips replay a generated trace instead: a deterministic tune written
+// through the registers their mappers forward to them. Each chip starts from power-up and outputs
+// into a Blip_Buffer that is ended and drained every frame; the time spent in the chip (register
+// writes and running its oscillators) and in the buffer (ending the frame and reading the samples)
+// are measured separately.
+
+using quickerNES::apu_log_t;
+using quickerNES::nes_addr_t;
+using quickerNES::nes_time_t;
+
+typedef std::vector<apu_log_t> trace_t;
+
+// CPU clock and frame length of the generated traces (NTSC)
+static const long clock_rate = 1789773;
+static const nes_time_t frame_length = 29780;
+
+// Length of the sample buffer in milliseconds, as the emulator uses
+static const int buffer_length = 1200 / 60;
+
+// Deterministic pseudo-random numbers, the same on every platform
+struct rng_t
+{
+  uint32_t state = 0x12345678;
+  int next(int n)
+  {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) % n;
+  }
+};
+
+// Receives the register writes of one generated frame, as (address, value)
+typedef std::function<void(nes_addr_t, int)> write_t;
+
+// Produces the register writes of the given frame
+typedef std::function<void(long frame, const write_t &, rng_t &)> tune_t;
+
+// Generates a trace where every frame has its writes in a burst, as a music driver run from the
+// NMI handler makes them
+static trace_t generate(long frameCount, tune_t tune)
+{
+  trace_t trace(frameCount);
+  rng_t rng;
+  for (long f = 0; f < frameCount; f++)
+  {
+    apu_log_t &log = trace[f];
+    nes_time_t time = 100 + rng.next(2000);
+    tune(f, [&](nes_addr_t addr, int data) { log.add(apu_log_t::sound_write, time += 8, addr, data); }, rng);
+    log.frame_length = frame_length;
+    log.end_time = frame_length;
+  }
+  return trace;
+}
+
+// Notes start at random on each channel and then fade out
+struct fade_t
+{
+  int volume = 0;
+  bool fade(long frame) { return volume > 0 && (frame & 3) == 0 && volume--; }
+};
+
+// Two squares and the saw, at $9000-$B002
+static tune_t vrc6_tune()
+{
+  return [channels = std::array<fade_t, 3>{}, duty = std::array<int, 3>{}](long frame, const write_t &write, rng_t &rng) mutable
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      const nes_addr_t base = 0x9000 + i * 0x1000;
+      if (rng.next(8) == 0)
+      {
+        const int period = 0x80 + rng.next(0xF00);
+        duty[i] = rng.next(8) << 4;
+        channels[i].volume = i < 2 ? 15 : 0x2A;
+        write(base, duty[i] | channels[i].volume);
+        write(base + 1, period & 0xFF);
+        write(base + 2, 0x80 | period >> 8);
+      }
+      else if (channels[i].fade(frame))
+        write(base, duty[i] | channels[i].volume);
+    }
+  };
+}
+
+// Three tones, through the latch at $C000 and data at $E000
+static tune_t fme7_tune()
+{
+  return [channels = std::array<fade_t, 3>{}](long frame, const write_t &write, rng_t &rng) mutable
+  {
+    auto reg = [&](int latch, int data)
+    {
+      write(0xC000, latch);
+      write(0xE000, data);
+    };
+
+    if (frame == 0) reg(7, 0x38);
+    for (int i = 0; i < 3; i++)
+    {
+      if (rng.next(8) == 0)
+      {
+        const int period = 0x40 + rng.next(0x3C0);
+        channels[i].volume = 15;
+        reg(i * 2, period & 0xFF);
+        reg(i * 2 + 1, period >> 8);
+        reg(8 + i, channels[i].volume);
+      }
+      else if (channels[i].fade(frame))
+        reg(8 + i, channels[i].volume);
+    }
+  };
+}
+
+// All eight channels over four 32-sample waves, through the address port at $F800 and data at $4800
+static tune_t namco_tune()
+{
+  return [channels = std::array<fade_t, 8>{}](long frame, const write_t &write, rng_t &rng) mutable
+  {
+    auto reg = [&](int addr, int data)
+    {
+      write(0xF800, addr);
+      write(0x4800, data);
+    };
+
+    // triangle, saw, 25% and 50% squares, two 4-bit samples per byte
+    auto sample = [](int index)
+    {
+      const int wave = index >> 5, phase = index & 31;
+      if (wave == 0) return phase < 16 ? phase : 31 - phase;
+      if (wave == 1) return phase >> 1;
+      if (wave == 2) return phase < 8 ? 15 : 0;
+      return phase < 16 ? 15 : 0;
+    };
+    if (frame == 0)
+    {
+      write(0xF800, 0x80);
+      for (int i = 0; i < 128; i += 2) write(0x4800, sample(i) | sample(i + 1) << 4);
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+      const int base = 0x40 + i * 8;
+      const int count = i == 7 ? 0x70 : 0; // channel 7's volume register also enables all eight channels
+      if (frame == 0) reg(base + 6, (i & 3) * 32);
+      if (rng.next(8) == 0)
+      {
+        const int freq = 0x4000 + rng.next(0x30000);
+        channels[i].volume = 15;
+        reg(base, freq & 0xFF);
+        reg(base + 2, freq >> 8 & 0xFF);
+        reg(base + 4, (256 - 32) | freq >> 16);
+        reg(base + 7, count | channels[i].volume);
+      }
+      else if (channels[i].fade(frame) || frame == 0)
+        reg(base + 7, count | channels[i].volume);
+    }
+  };
+}
+
+// Six FM channels on the built-in instruments, through the register select at $9010 and data at $9030
+static tune_t vrc7_tune()
+{
+  return [](long frame, const write_t &write, rng_t &rng)
+  {
+    auto reg = [&](int addr, int data)
+    {
+      write(0x9010, addr);
+      write(0x9030, data);
+    };
+
+    for (int i = 0; i < 6; i++)
+    {
+      const int roll = rng.next(16);
+      if (roll < 2)
+      {
+        const int fnum = 0x100 + rng.next(0x100), octave = 2 + rng.next(4);
+        reg(0x20 + i, octave << 1 | fnum >> 8);
+        reg(0x30 + i, (1 + rng.next(15)) << 4 | rng.next(4));
+        reg(0x10 + i, fnum & 0xFF);
+        reg(0x20 + i, 0x30 | octave << 1 | fnum >> 8);
+      }
+      else if (roll == 2)
+        reg(0x20 + i, 0);
+    }
+  };
+}
+
+// Cursor over the bytes the DMC read in a recorded frame
+struct dmc_replay_t
+{
+  const uint8_t *next;
+  const uint8_t *end;
+};
+
+static int replay_dmc(void *data, nes_addr_t)
+{
+  dmc_replay_t *dmc = (dmc_replay_t *)data;
+  return dmc->next < dmc->end ? *dmc->next++ : 0;
+}
+
+struct result_t
+{
+  double chipSeconds = 0.0;
+  double bufferSeconds = 0.0;
+  size_t sampleCount = 0;
+  jaffarCommon::hash::hash_t sampleHash;
+};
+
+// Replays the trace into a new Chip, running each frame with play(chip, log), and keeps the fastest
+// of the repetitions
+template <class Chip>
+static result_t measure(const trace_t &trace, long sampleRate, int repeatCount, std::function<void(Chip &, const apu_log_t &)> play)
+{
+  result_t result;
+  std::vector<short> samples, frameSamples;
+  for (int r = 0; r < repeatCount; r++)
+  {
+    auto chip = std::make_unique<Chip>();
+    quickerNES::Blip_Buffer buffer;
+    const char *error = buffer.set_sample_rate(sampleRate, buffer_length);
+    if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not set sample rate: %s\n", error);
+    buffer.clock_rate(clock_rate);
+    chip->output(&buffer);
+    frameSamples.resize(buffer.sample_rate() * buffer_length / 1000 + 1);
+
+    double chipSeconds = 0.0, bufferSeconds = 0.0;
+    for (const auto &log : trace)
+    {
+      auto t0 = std::chrono::high_resolution_clock::now();
+      play(*chip, log);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      buffer.end_frame(log.frame_length);
+      long count = buffer.read_samples(frameSamples.data(), frameSamples.size());
+      auto t2 = std::chrono::high_resolution_clock::now();
+
+      chipSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+      bufferSeconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() * 1.0e-9;
+      if (r == 0) samples.insert(samples.end(), frameSamples.begin(), frameSamples.begin() + count);
+    }
+
+    if (r == 0 || chipSeconds + bufferSeconds < result.chipSeconds + result.bufferSeconds)
+    {
+      result.chipSeconds = chipSeconds;
+      result.bufferSeconds = bufferSeconds;
+    }
+  }
+
+  result.sampleCount = samples.size();
+  result.sampleHash = jaffarCommon::hash::calculateMetroHash(samples.data(), samples.size() * sizeof(short));
+  return result;
+}
+
+// Expansion sound accesses of the frame, which the mapper would pass to its chip
+static void play_sound(quickerNES::Expansion_Apu &chip, const apu_log_t &log)
+{
+  for (const auto &e : log.events)
+  {
+    if (e.kind == apu_log_t::sound_write) chip.write_register(e.time, e.addr, e.data);
+    if (e.kind == apu_log_t::sound_read) chip.read_register(e.time, e.addr);
+  }
+  chip.end_frame(log.end_time);
+}
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("soundBenchmark", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file whose sequence the traces are recorded from.")
+    .required();
+
+  program.add_argument("--rate")
+    .help("Output sample rate.")
+    .default_value(std::string("44100"));
+
+  program.add_argument("--repeat")
+    .help("Number of times each chip replays its trace; the fastest run is reported.")
+    .default_value(std::string("5"));
+
+  // Try to parse arguments
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str());
+  }
+
+  // Getting test script file path
+  std::string scriptFilePath = program.get<std::string>("scriptFile");
+
+  // Getting sample rate
+  const long sampleRate = std::stol(program.get<std::string>("--rate"));
+  if (sampleRate < 1) JAFFAR_THROW_LOGIC("Sample rate must be positive\n");
+
+  // Getting repetition count
+  const int repeatCount = std::stoi(program.get<std::string>("--repeat"));
+  if (repeatCount < 1) JAFFAR_THROW_LOGIC("Repetition count must be at least 1\n");
+
+  // Loading script file
+  std::string scriptJsonRaw;
+  if (jaffarCommon::file::loadStringFromFile(scriptJsonRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+
+  // Parsing script
+  const auto scriptJson = nlohmann::json::parse(scriptJsonRaw);
+
+  // Getting rom, initial state and sequence file paths
+  if (scriptJson.contains("Rom File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Rom File' entry\n");
+  if (scriptJson.contains("Initial State File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Initial State File' entry\n");
+  if (scriptJson.contains("Sequence File") == false) JAFFAR_THROW_LOGIC("Script file missing 'Sequence File' entry\n");
+  std::string romFilePath = scriptJson["Rom File"].get<std::string>();
+  std::string initialStateFilePath = scriptJson["Initial State File"].get<std::string>();
+  std::string sequenceFilePath = scriptJson["Sequence File"].get<std::string>();
+
+  // Loading ROM
+  std::string romFileData;
+  if (jaffarCommon::file::loadStringFromFile(romFileData, romFilePath) == false) JAFFAR_THROW_LOGIC("Could not rom file: %s\n", romFilePath.c_str());
+
+  // Creating the emulating instance
+  NESInstance e(scriptJson);
+  e.loadROM((uint8_t *)romFileData.data(), romFileData.size());
+  auto emulator = (quickerNES::Emu *)e.getInternalEmulatorPointer();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, '\n');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+  const size_t sequenceLength = decodedSequence.size();
+
+  // Recording the sound events of every frame, headless
+  trace_t recorded(sequenceLength);
+  for (size_t i = 0; i < sequenceLength; i++)
+  {
+    emulator->set_apu_log(&recorded[i]);
+    emulator->emulate_skip_frame(decodedSequence[i].port1, decodedSequence[i].port2, 0, 0);
+  }
+  emulator->set_apu_log(nullptr);
+  const int mapper = emulator->cart()->mapper_code();
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", sequenceLength);
+  printf("[] Mapper:                                 %d\n", mapper);
+  printf("[] Sample Rate:                            %ld\n", sampleRate);
+  printf("[] Repetitions:                            %d\n", repeatCount);
+  printf("[] ********** Running Test **********\n");
+  fflush(stdout);
+
+  auto report = [&](const char *name, const char *source, const result_t &r)
+  {
+    const double frames = (double)sequenceLength;
+    printf("[] %-10s %-10s %9.3f us / frame chip, %9.3f us / frame Blip_Buffer, %lu samples, Sample Hash 0x%lX%lX\n", name, source, r.chipSeconds * 1.0e6 / frames, r.bufferSeconds * 1.0e6 / frames, r.sampleCount, r.sampleHash.first, r.sampleHash.second);
+    fflush(stdout);
+  };
+
+  // APU register writes, $4015 reads and the DMC's fetches
+  dmc_replay_t dmc;
+  auto apu = measure<quickerNES::Apu>(recorded, sampleRate, repeatCount, [&](quickerNES::Apu &chip, const apu_log_t &log)
+  {
+    dmc = {log.dmc_data.data(), log.dmc_data.data() + log.dmc_data.size()};
+    chip.dmc_reader(replay_dmc, &dmc);
+    for (const auto &e : log.events)
+    {
+      if (e.kind == apu_log_t::apu_write) chip.write_register(e.time, e.addr, e.data);
+      if (e.kind == apu_log_t::status_read) chip.read_status(e.time);
+    }
+    chip.end_frame(log.frame_length);
+  });
+  report("APU", "recorded", apu);
+
+  // Expansion chips, replaying the recorded trace if the cartridge has the chip
+  auto traceFor = [&](int code, tune_t tune) { return mapper == code ? recorded : generate(sequenceLength, tune); };
+  auto sourceFor = [&](int code) { return mapper == code ? "recorded" : "generated"; };
+
+  auto namco = measure<quickerNES::Namco_Apu>(traceFor(19, namco_tune()), sampleRate, repeatCount, play_sound);
+  report("Namco 163", sourceFor(19), namco);
+
+  auto vrc6 = measure<quickerNES::Vrc6_Apu>(traceFor(24, vrc6_tune()), sampleRate, repeatCount, play_sound);
+  report("VRC6", sourceFor(24), vrc6);
+
+  auto fme7 = measure<quickerNES::Fme7_Apu>(traceFor(69, fme7_tune()), sampleRate, repeatCount, play_sound);
+  report("FME-7", sourceFor(69), fme7);
+
+  auto vrc7 = measure<quickerNES::Vrc7>(traceFor(85, vrc7_tune()), sampleRate, repeatCount, play_sound);
+  report("VRC7", sourceFor(85), vrc7);
+
+  // If reached this point, everything ran ok
+  return 0;
+}
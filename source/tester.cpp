@@ -1,6 +1,10 @@
+#include "batchEngine.hpp"
 #include "nesInstance.hpp"
+#include "transpositionCache.hpp"
+#include <algorithm>
 #include <argparse/argparse.hpp>
 #include <chrono>
+#include <cmath>
 #include <jaffarCommon/deserializers/contiguous.hpp>
 #include <jaffarCommon/deserializers/differential.hpp>
 #include <jaffarCommon/file.hpp>
@@ -26,6 +30,47 @@ int main(int argc, char *argv[])
     .help("Specifies the emulation actions to be performed per each input. Possible values: 'Simple': performs only advance state, 'Rerecord': performs load/advance/save, and 'Full': performs load/advance/save/advance.")
     .default_value(std::string("Simple"));
 
+  program.add_argument("--transpositionCache")
+    .help("Maximum number of (state, input) -> successor entries to memoize around advance state. Zero disables the cache.")
+    .default_value(std::string("0"));
+
+  program.add_argument("--allStateBlocks")
+    .help("Keeps every state block in the serialized state, ignoring the script's 'Disable State Blocks'. The transposition cache is only exact this way.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--batchScaling")
+    .help("Measures the scaling of the batch engine when expanding every (state, input) pair of the sequence with 1 up to the given number of threads. Zero disables the measurement.")
+    .default_value(std::string("0"));
+
+  program.add_argument("--frameStats")
+    .help("Replays the sequence once more collecting per-frame emulation statistics, and prints their totals and percentiles. Requires a core built with statistics.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--renderBenchmark")
+    .help("Replays the sequence once more with and without rendering, and compares the vectorised renderer against the scalar one when the core has both.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--audio")
+    .help("Replays the sequence once more with and without a sound buffer attached, producing samples at the given rate and reading them after every frame. Zero disables the measurement.")
+    .default_value(std::string("0"));
+
+  program.add_argument("--audioBuffer")
+    .help("Sound buffer attached by --audio. Possible values: 'Mono': mono samples, 'Effects': stereo samples with the NES effects buffer.")
+    .default_value(std::string("Mono"));
+
+  program.add_argument("--observation")
+    .help("Replays the sequence once more drawing downsampled observations, and checks them against the same downsampling applied to the full frames: nearest 84x84 grayscale, box filtered 84x84 grayscale, and a cropped half size palette image.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--watches")
+    .help("Replays the sequence once more with PC, RAM write, scanline and cycle watches armed, resuming every frame they stop mid-way, and checks that it ends in the same state as the plain replay.")
+    .default_value(false)
+    .implicit_value(true);
+
   program.add_argument("--hashOutputFile")
     .help("Path to write the hash output to.")
     .default_value(std::string(""));
@@ -49,6 +94,33 @@ int main(int argc, char *argv[])
   // Getting reproduce flag
   std::string cycleType = program.get<std::string>("--cycleType");
 
+  // Getting transposition cache size
+  const size_t transpositionCacheEntries = std::stoul(program.get<std::string>("--transpositionCache"));
+
+  // Getting whether to keep every state block
+  const bool allStateBlocks = program.get<bool>("--allStateBlocks");
+
+  // Getting maximum number of batch engine threads to measure
+  const size_t batchScalingThreads = std::stoul(program.get<std::string>("--batchScaling"));
+
+  // Getting frame statistics flag
+  const bool frameStatsEnabled = program.get<bool>("--frameStats");
+
+  // Getting rendering benchmark flag
+  const bool renderBenchmarkEnabled = program.get<bool>("--renderBenchmark");
+
+  // Getting audio benchmark sample rate and buffer
+  const long audioSampleRate = std::stol(program.get<std::string>("--audio"));
+  if (audioSampleRate < 0) JAFFAR_THROW_LOGIC("Audio sample rate must not be negative\n");
+  std::string audioBuffer = program.get<std::string>("--audioBuffer");
+  if (audioBuffer != "Mono" && audioBuffer != "Effects") JAFFAR_THROW_LOGIC("Audio buffer not recognized: '%s'\n", audioBuffer.c_str());
+
+  // Getting observation check flag
+  const bool observationEnabled = program.get<bool>("--observation");
+
+  // Getting watch replay flag
+  const bool watchesEnabled = program.get<bool>("--watches");
+
   // Loading script file
   std::string scriptJsonRaw;
   if (jaffarCommon::file::loadStringFromFile(scriptJsonRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
@@ -87,6 +159,11 @@ int main(int argc, char *argv[])
     stateDisabledBlocks.push_back(entry.get<std::string>());
     stateDisabledBlocksOutput += entry.get<std::string>() + std::string(" ");
   }
+  if (allStateBlocks == true)
+  {
+    stateDisabledBlocks.clear();
+    stateDisabledBlocksOutput.clear();
+  }
 
   // Getting Controller 1 type
   if (scriptJson.contains("Controller 1 Type") == false) JAFFAR_THROW_LOGIC("Script file missing 'Controller 1 Type' entry\n");
@@ -196,6 +273,12 @@ int main(int argc, char *argv[])
     printf("[]   + Fixed Diff State Size:              %lu\n", fixedDiferentialStateSize);
     printf("[]   + Full Diff State Size:               %lu\n", fullDifferentialStateSize);
   }
+  printf("[] Transposition Cache Entries:            %lu\n", transpositionCacheEntries);
+  printf("[] Batch Scaling Threads:                  %lu\n", batchScalingThreads);
+  printf("[] Frame Statistics:                       %s\n", frameStatsEnabled ? "true" : "false");
+  printf("[] Render Benchmark:                       %s\n", renderBenchmarkEnabled ? "true" : "false");
+  printf("[] Audio Benchmark Sample Rate:            %ld\n", audioSampleRate);
+  if (audioSampleRate > 0) printf("[]   + Buffer:                             %s\n", audioBuffer.c_str());
   printf("[] ********** Running Test **********\n");
 
   fflush(stdout);
@@ -220,6 +303,26 @@ int main(int argc, char *argv[])
     differentialStateMaxSizeDetected = s.getOutputSize();
   }
 
+  // Creating transposition cache, if requested, and keeping the initial state to measure its net speedup later
+  std::unique_ptr<TranspositionCache> transpositionCache;
+  std::vector<uint8_t> transpositionCacheScratch;
+  std::vector<uint8_t> initialState;
+  if (transpositionCacheEntries > 0)
+  {
+    transpositionCache = std::make_unique<TranspositionCache>(transpositionCacheEntries, stateSize);
+    transpositionCacheScratch.resize(stateSize);
+  }
+
+  // The initial state is replayed from after the timed run
+  if (transpositionCacheEntries > 0 || frameStatsEnabled == true || renderBenchmarkEnabled == true || audioSampleRate > 0 || observationEnabled == true || watchesEnabled == true) initialState.assign(currentState, currentState + stateSize);
+
+  // Advances state, going through the transposition cache if enabled
+  auto advanceState = [&](const jaffar::input_t &input)
+  {
+    if (transpositionCache == nullptr) e.advanceState(input);
+    if (transpositionCache != nullptr) transpositionCache->advanceState(e, input, transpositionCacheScratch.data());
+  };
+
   // Check whether to perform each action
   bool doPreAdvance = cycleType == "Full";
   bool doDeserialize = cycleType == "Rerecord" || cycleType == "Full";
@@ -229,7 +332,7 @@ int main(int argc, char *argv[])
   auto t0 = std::chrono::high_resolution_clock::now();
   for (const auto &input : decodedSequence)
   {
-    if (doPreAdvance == true) e.advanceState(input);
+    if (doPreAdvance == true) advanceState(input);
 
     if (doDeserialize == true)
     {
@@ -246,7 +349,7 @@ int main(int argc, char *argv[])
       }
     }
 
-    e.advanceState(input);
+    advanceState(input);
 
     if (doSerialize == true)
     {
@@ -273,6 +376,18 @@ int main(int argc, char *argv[])
   // Calculating final state hash
   auto result = jaffarCommon::hash::calculateMetroHash(e.getLowMem(), e.getLowMemSize());
 
+  // Keeping the hash of the full final state, which the run without the transposition cache must reproduce
+  jaffarCommon::hash::hash_t cachedFinalStateHash;
+  std::vector<uint8_t> finalState;
+  auto hashFullState = [&]()
+  {
+    finalState.resize(stateSize);
+    jaffarCommon::serializer::Contiguous s(finalState.data(), stateSize);
+    e.serializeState(s);
+    return jaffarCommon::hash::calculateMetroHash(finalState.data(), stateSize);
+  };
+  if (transpositionCache != nullptr) cachedFinalStateHash = hashFullState();
+
   // Creating hash string
   char hashStringBuffer[256];
   sprintf(hashStringBuffer, "0x%lX%lX", result.first, result.second);
@@ -285,6 +400,399 @@ int main(int argc, char *argv[])
   {
     printf("[] Differential State Max Size Detected:   %lu\n", differentialStateMaxSizeDetected);
   }
+
+  // Replays the sequence from the initial state, calling setup once it is loaded and perFrame after every input, and returns the time spent advancing
+  auto replaySequence = [&](auto &&setup, auto &&perFrame)
+  {
+    jaffarCommon::deserializer::Contiguous d(initialState.data(), stateSize);
+    e.deserializeState(d);
+    setup();
+
+    double seconds = 0.0;
+    for (size_t frame = 0; frame < sequenceLength; frame++)
+    {
+      auto r0 = std::chrono::high_resolution_clock::now();
+      e.advanceState(decodedSequence[frame]);
+      auto rf = std::chrono::high_resolution_clock::now();
+      seconds += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(rf - r0).count() * 1.0e-9;
+      perFrame(frame);
+    }
+    return seconds;
+  };
+
+  // The replays that render draw into a local video buffer, which is also what makes the core produce sound
+  auto emulator = (emulator_t *)e.getInternalEmulatorPointer();
+  std::vector<uint8_t> videoBuffer;
+  if (renderBenchmarkEnabled == true || audioSampleRate > 0 || observationEnabled == true)
+  {
+    videoBuffer.resize(emulator_t::buffer_width * emulator->buffer_height());
+    emulator->set_pixels(videoBuffer.data(), emulator_t::buffer_width);
+  }
+
+  // If requested, replay the sequence and report the per-frame statistics of the core
+  if (frameStatsEnabled == true)
+  {
+    std::vector<std::pair<const char *, uint64_t>> frameStats;
+    std::vector<const char *> statNames;
+    std::vector<std::vector<uint64_t>> statValues;
+    replaySequence([]() {},
+                   [&](const size_t)
+                   {
+                     e.getFrameStats(frameStats);
+                     if (statNames.empty())
+                       for (const auto &stat : frameStats) statNames.push_back(stat.first);
+                     statValues.resize(frameStats.size());
+                     for (size_t i = 0; i < frameStats.size(); i++) statValues[i].push_back(frameStats[i].second);
+                   });
+
+    if (statNames.empty()) printf("[] Frame Statistics:                       not collected by this core build\n");
+    if (statNames.empty() == false)
+    {
+      // Nearest-rank percentile of a sorted list of per-frame values
+      auto percentile = [](const std::vector<uint64_t> &sorted, const double p)
+      {
+        size_t rank = (size_t)std::ceil(p * (double)sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+      };
+
+      printf("[] Frame Statistics (%lu frames):\n", sequenceLength);
+      printf("[]   %-26s %14s %12s %10s %10s %10s %10s\n", "Counter", "Total", "Per Frame", "p50", "p90", "p99", "Max");
+      for (size_t i = 0; i < statNames.size(); i++)
+      {
+        auto values = statValues[i];
+        std::sort(values.begin(), values.end());
+        uint64_t total = 0;
+        for (const auto value : values) total += value;
+        printf("[]   %-26s %14lu %12.2f %10lu %10lu %10lu %10lu\n", statNames[i], total, (double)total / (double)values.size(), percentile(values, 0.50), percentile(values, 0.90), percentile(values, 0.99), values.back());
+      }
+    }
+  }
+
+  // If requested, replay the sequence rendering every frame into the video buffer
+  if (renderBenchmarkEnabled == true)
+  {
+    // Pixels are host palette entries, which depend on the palette history; frames are compared as NES colors
+    std::vector<uint16_t> frameColors(image_width * image_height);
+    auto hashFrame = [&]()
+    {
+      const auto &frame = emulator->frame();
+      for (size_t y = 0; y < image_height; y++)
+        for (size_t x = 0; x < image_width; x++) frameColors[y * image_width + x] = frame.palette[frame.pixels[y * frame.pitch + x]];
+      return jaffarCommon::hash::calculateMetroHash(frameColors.data(), frameColors.size() * sizeof(uint16_t));
+    };
+
+    // Replays the sequence, returning the emulation time and the hash of every frame
+    auto replay = [&](const bool rendering, std::vector<jaffarCommon::hash::hash_t> &frameHashes)
+    {
+      frameHashes.clear();
+      const double seconds = replaySequence(
+        [&]()
+        {
+          if (rendering == true) e.enableRendering();
+          if (rendering == false) e.disableRendering();
+        },
+        [&](const size_t)
+        {
+          if (rendering == true) frameHashes.push_back(hashFrame());
+        });
+
+      e.disableRendering();
+      return seconds;
+    };
+
+    // Rendering cost per frame, in microseconds, over the run without rendering
+    std::vector<jaffarCommon::hash::hash_t> skipHashes, frameHashes, scalarFrameHashes;
+    const double skipSeconds = replay(false, skipHashes);
+    auto renderCost = [&](const double seconds) { return (seconds - skipSeconds) * 1.0e6 / (double)sequenceLength; };
+
+    const bool hasSIMDRendering = e.setSIMDRendering(true);
+    const double renderSeconds = replay(true, frameHashes);
+    const auto lastFrameHash = frameHashes.empty() ? jaffarCommon::hash::hash_t() : frameHashes.back();
+
+    printf("[] Render Benchmark Without Rendering:     %.3f inputs / s\n", (double)sequenceLength / skipSeconds);
+    printf("[] Render Benchmark With Rendering:        %.3f inputs / s (%.3f us / frame rendering)\n", (double)sequenceLength / renderSeconds, renderCost(renderSeconds));
+    printf("[] Render Benchmark Last Frame Hash:       0x%lX%lX\n", lastFrameHash.first, lastFrameHash.second);
+
+    // The scalar renderer must produce exactly the same frames
+    if (hasSIMDRendering == true)
+    {
+      e.setSIMDRendering(false);
+      const double scalarSeconds = replay(true, scalarFrameHashes);
+      e.setSIMDRendering(true);
+
+      printf("[] Render Benchmark Scalar Renderer:       %.3f inputs / s (%.3f us / frame rendering)\n", (double)sequenceLength / scalarSeconds, renderCost(scalarSeconds));
+      printf("[] Render Benchmark SIMD Speedup:          %.3fx rendering\n", renderCost(scalarSeconds) / renderCost(renderSeconds));
+      if (scalarFrameHashes != frameHashes) JAFFAR_THROW_LOGIC("[ERROR] Vectorised and scalar renderers produced different frames\n");
+    }
+  }
+
+  // If requested, replay the sequence rendering every frame, first without sound and then with a sound buffer attached
+  if (audioSampleRate > 0)
+  {
+    // Replays the sequence, reading the samples of every frame into a local buffer
+    std::vector<int16_t> samples, frameSamples(16384);
+    auto replay = [&](const bool audio)
+    {
+      samples.clear();
+      const double seconds = replaySequence([&]() { e.enableRendering(); },
+                                            [&](const size_t)
+                                            {
+                                              if (audio == false) return;
+                                              const size_t count = e.readAudioSamples(frameSamples.data(), frameSamples.size());
+                                              samples.insert(samples.end(), frameSamples.begin(), frameSamples.begin() + count);
+                                            });
+
+      e.disableRendering();
+      return seconds;
+    };
+
+    // Once attached, the sound buffer stays attached, so the run without sound goes first
+    const double silentSeconds = replay(false);
+    printf("[] Audio Benchmark Without Audio:          %.3f inputs / s\n", (double)sequenceLength / silentSeconds);
+
+    if (e.enableAudio(audioSampleRate, audioBuffer == "Effects") == false) printf("[] Audio Benchmark With Audio:             not supported by this core\n");
+    else
+    {
+      const double audioSeconds = replay(true);
+      const auto sampleHash = jaffarCommon::hash::calculateMetroHash(samples.data(), samples.size() * sizeof(int16_t));
+      printf("[] Audio Benchmark With Audio:             %.3f inputs / s (%.3f us / frame sound)\n", (double)sequenceLength / audioSeconds, (audioSeconds - silentSeconds) * 1.0e6 / (double)sequenceLength);
+      printf("[] Audio Benchmark Samples Produced:       %lu\n", samples.size());
+      printf("[] Audio Benchmark Sample Hash:            0x%lX%lX\n", sampleHash.first, sampleHash.second);
+    }
+  }
+
+  // If requested, replay the sequence drawing observations, which must match the full frames downsampled here
+  if (observationEnabled == true)
+  {
+    struct observationCase_t
+    {
+      const char *name;
+      emulator_t::observation_t observation;
+      emulator_t::observation_format_t format;
+    };
+    const std::vector<observationCase_t> observationCases = {
+      {"Nearest 84x84", {0, 0, image_width, image_height, 84, 84, false}, emulator_t::observation_grayscale},
+      {"Box Filter 84x84", {0, 0, image_width, image_height, 84, 84, true}, emulator_t::observation_grayscale},
+      {"Cropped Palette", {8, 8, 240, 224, 120, 112, false}, emulator_t::observation_palette},
+    };
+
+    // Same sample positions, ITU-R BT.601 luma and rounding as the emulator
+    auto luma = [](const int color)
+    {
+      const auto &rgb = emulator_t::nes_colors[color];
+      return (rgb.red * 299 + rgb.green * 587 + rgb.blue * 114 + 500) / 1000;
+    };
+    std::vector<uint8_t> expected;
+    auto downsample = [&](const observationCase_t &c)
+    {
+      const auto &frame = emulator->frame();
+      auto color = [&](const int x, const int y) { return (int)frame.palette[frame.pixels[y * frame.pitch + x]]; };
+      const auto &o = c.observation;
+
+      expected.resize(o.out_width * o.out_height);
+      for (int y = 0; y < o.out_height; y++)
+        for (int x = 0; x < o.out_width; x++)
+        {
+          const int x0 = o.left + (2 * x + 1) * o.width / (2 * o.out_width);
+          const int y0 = o.top + (2 * y + 1) * o.height / (2 * o.out_height);
+          const int x1 = std::min(x0 + 1, o.left + o.width - 1);
+          const int y1 = std::min(y0 + 1, o.top + o.height - 1);
+          uint8_t value = c.format == emulator_t::observation_palette ? color(x0, y0) & 0x3F : luma(color(x0, y0));
+          if (o.box_filter == true) value = (luma(color(x0, y0)) + luma(color(x1, y0)) + luma(color(x0, y1)) + luma(color(x1, y1)) + 2) >> 2;
+          expected[y * o.out_width + x] = value;
+        }
+      return jaffarCommon::hash::calculateMetroHash(expected.data(), expected.size());
+    };
+
+    // Downsampling every full frame for all cases at once
+    std::vector<std::vector<jaffarCommon::hash::hash_t>> expectedHashes(observationCases.size());
+    replaySequence([&]() { e.enableRendering(); },
+                   [&](const size_t)
+                   {
+                     for (size_t i = 0; i < observationCases.size(); i++) expectedHashes[i].push_back(downsample(observationCases[i]));
+                   });
+
+    // Drawing only the observation of each case, frame by frame
+    for (size_t i = 0; i < observationCases.size(); i++)
+    {
+      const auto &c = observationCases[i];
+      std::vector<uint8_t> observation(c.observation.out_width * c.observation.out_height);
+      const char *error = emulator->set_observation(observation.data(), c.observation.out_width, c.observation, c.format);
+      if (error != nullptr) JAFFAR_THROW_LOGIC("[ERROR] Could not set the %s observation: %s\n", c.name, error);
+
+      const double seconds = replaySequence([]() {},
+                                            [&](const size_t frame)
+                                            {
+                                              const auto hash = jaffarCommon::hash::calculateMetroHash(observation.data(), observation.size());
+                                              if (hash != expectedHashes[i][frame]) JAFFAR_THROW_LOGIC("[ERROR] %s observation of frame %lu differs from the downsampled full frame\n", c.name, frame);
+                                            });
+      printf("[] Observation %-18s           %.3f inputs / s (matches the full frames)\n", (std::string(c.name) + ":").c_str(), (double)sequenceLength / seconds);
+    }
+
+    emulator->set_pixels(videoBuffer.data(), emulator_t::buffer_width);
+    e.disableRendering();
+  }
+
+  // If requested, replay the sequence with watches stopping emulation mid-frame, which must not change the emulation
+  if (watchesEnabled == true)
+  {
+    // The NMI handler is entered every frame, giving PC stops at a different point than the timed ones
+    const int nmiAddress = emulator->peek_prg(0xFFFA) | (emulator->peek_prg(0xFFFB) << 8);
+
+    // Cycle watches only trigger once, so all watches are set again once each frame has finished
+    std::vector<size_t> watchStops(4);
+    auto armWatches = [&]()
+    {
+      emulator->clear_watches();
+      emulator->add_pc_watch(nmiAddress);
+      emulator->add_ram_write_watch(0x0000);
+      emulator->add_scanline_watch(120);
+      emulator->add_cycle_watch(10000);
+    };
+
+    // Replays the sequence, returning the hashes of the low memory and of the full final state
+    auto replay = [&](const bool watches)
+    {
+      replaySequence(
+        [&]()
+        {
+          if (watches == true) armWatches();
+        },
+        [&](const size_t)
+        {
+          while (emulator->frame_in_progress() == true)
+          {
+            watchStops[emulator->triggered_watch()]++;
+            emulator->resume_frame();
+          }
+          if (watches == true) armWatches();
+        });
+
+      emulator->clear_watches();
+      return std::make_pair(jaffarCommon::hash::calculateMetroHash(e.getLowMem(), e.getLowMemSize()), hashFullState());
+    };
+
+    const auto plainHashes = replay(false);
+    const auto watchHashes = replay(true);
+
+    printf("[] Watch Stops (PC / RAM / Line / Cycle):  %lu / %lu / %lu / %lu\n", watchStops[0], watchStops[1], watchStops[2], watchStops[3]);
+    if (plainHashes.first != result) JAFFAR_THROW_LOGIC("[ERROR] Plain replay (0x%lX%lX) differs from the timed run (0x%lX%lX)\n", plainHashes.first.first, plainHashes.first.second, result.first, result.second);
+    if (watchHashes.first != plainHashes.first) JAFFAR_THROW_LOGIC("[ERROR] Final state hash with watches (0x%lX%lX) differs from the plain replay (0x%lX%lX)\n", watchHashes.first.first, watchHashes.first.second, plainHashes.first.first, plainHashes.first.second);
+    if (watchHashes.second != plainHashes.second) JAFFAR_THROW_LOGIC("[ERROR] Full final state with watches (0x%lX%lX) differs from the plain replay (0x%lX%lX)\n", watchHashes.second.first, watchHashes.second.second, plainHashes.second.first, plainHashes.second.second);
+    printf("[] Watch Final State Hash:                 0x%lX%lX (matches the plain replay)\n", watchHashes.first.first, watchHashes.first.second);
+  }
+
+  // If using the transposition cache, report its statistics and compare against a run without it, which must end in the same state
+  if (transpositionCache != nullptr)
+  {
+    // The run saves and loads its own copy, leaving the initial state as it is
+    std::vector<uint8_t> referenceState(initialState);
+    {
+      jaffarCommon::deserializer::Contiguous d(referenceState.data(), stateSize);
+      e.deserializeState(d);
+    }
+
+    auto r0 = std::chrono::high_resolution_clock::now();
+    for (const auto &input : decodedSequence)
+    {
+      if (doPreAdvance == true) e.advanceState(input);
+      if (doDeserialize == true)
+      {
+        jaffarCommon::deserializer::Contiguous d(referenceState.data(), stateSize);
+        e.deserializeState(d);
+      }
+      e.advanceState(input);
+      if (doSerialize == true)
+      {
+        auto s = jaffarCommon::serializer::Contiguous(referenceState.data(), stateSize);
+        e.serializeState(s);
+      }
+    }
+    auto rf = std::chrono::high_resolution_clock::now();
+    auto referenceDt = std::chrono::duration_cast<std::chrono::nanoseconds>(rf - r0).count();
+
+    const auto uncachedFinalStateHash = hashFullState();
+    if (uncachedFinalStateHash != cachedFinalStateHash) JAFFAR_THROW_LOGIC("[ERROR] Final state with the transposition cache (0x%lX%lX) differs from the one without it (0x%lX%lX)\n", cachedFinalStateHash.first, cachedFinalStateHash.second, uncachedFinalStateHash.first, uncachedFinalStateHash.second);
+
+    printf("[] Transposition Cache Hit Rate:           %.3f%% (%lu hits / %lu misses)\n", transpositionCache->getHitRate() * 100.0, transpositionCache->getHitCount(), transpositionCache->getMissCount());
+    printf("[] Transposition Cache Entries Used:       %lu (%lu evictions)\n", transpositionCache->getEntryCount(), transpositionCache->getEvictionCount());
+    printf("[] Transposition Cache Memory Use:         %.3f MB\n", (double)transpositionCache->getMemoryUsage() / (1024.0 * 1024.0));
+    printf("[] Transposition Cache Uncached Time:      %3.3fs\n", (double)referenceDt * 1.0e-9);
+    printf("[] Transposition Cache Net Speedup:        %.3fx\n", (double)referenceDt / (double)dt);
+    printf("[] Transposition Cache Final State Hash:   0x%lX%lX (matches the uncached run)\n", cachedFinalStateHash.first, cachedFinalStateHash.second);
+  }
+  // If requested, measure the batch engine expanding every (state, input) pair of the sequence
+  if (batchScalingThreads > 0)
+  {
+    // Instances keep all state blocks, so that any parent state can be expanded by any thread
+    auto setup = [&](NESInstanceBase &instance)
+    {
+      instance.disableRendering();
+      if (useFlatCodeMap == true) instance.useFlatCodeMap();
+    };
+
+    // Producing the parent states and the expected child hashes sequentially
+    std::vector<uint8_t> parentStates;
+    std::vector<jaffarCommon::hash::hash_t> expectedHashes;
+    size_t batchStateSize;
+    {
+      BatchEngine<NESInstance> engine(scriptJson, (uint8_t *)romFileData.data(), romFileData.size(), 1, setup);
+      auto &instance = engine.getInstance(0);
+      batchStateSize = engine.getStateSize();
+
+      if (initialStateFilePath != "")
+      {
+        std::string stateFileData;
+        jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath);
+        jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+        instance.deserializeState(d);
+      }
+
+      parentStates.resize(sequenceLength * batchStateSize);
+      for (size_t i = 0; i < sequenceLength; i++)
+      {
+        jaffarCommon::serializer::Contiguous s(&parentStates[i * batchStateSize], batchStateSize);
+        instance.serializeState(s);
+        instance.advanceState(decodedSequence[i]);
+
+        std::vector<uint8_t> childState(batchStateSize);
+        jaffarCommon::serializer::Contiguous cs(childState.data(), batchStateSize);
+        instance.serializeState(cs);
+        expectedHashes.push_back(jaffarCommon::hash::calculateMetroHash(childState.data(), batchStateSize));
+      }
+    }
+
+    std::vector<BatchEngine<NESInstance>::job_t> jobs(sequenceLength);
+    for (size_t i = 0; i < sequenceLength; i++) jobs[i] = {&parentStates[i * batchStateSize], decodedSequence[i]};
+    std::vector<jaffarCommon::hash::hash_t> childHashes(sequenceLength);
+
+    // Measuring doubling thread counts, and the maximum
+    std::vector<size_t> threadCounts;
+    for (size_t threadCount = 1; threadCount < batchScalingThreads; threadCount *= 2) threadCounts.push_back(threadCount);
+    threadCounts.push_back(batchScalingThreads);
+
+    double singleThreadRate = 0.0;
+    for (const auto threadCount : threadCounts)
+    {
+      BatchEngine<NESInstance> engine(scriptJson, (uint8_t *)romFileData.data(), romFileData.size(), threadCount, setup);
+
+      auto b0 = std::chrono::high_resolution_clock::now();
+      engine.run(jobs.data(), jobs.size(), nullptr, childHashes.data());
+      auto bf = std::chrono::high_resolution_clock::now();
+      double batchSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(bf - b0).count() * 1.0e-9;
+
+      for (size_t i = 0; i < sequenceLength; i++)
+        if (childHashes[i] != expectedHashes[i]) JAFFAR_THROW_LOGIC("Batch engine child state %lu differs from sequential emulation with %lu threads\n", i, threadCount);
+
+      size_t steals = 0;
+      for (size_t i = 0; i < threadCount; i++) steals += engine.getStealCount(i);
+
+      double rate = (double)sequenceLength / batchSeconds;
+      if (threadCount == 1) singleThreadRate = rate;
+      printf("[] Batch Scaling (%3lu threads):            %.3f states / s - Speedup: %.3fx - Efficiency: %.1f%% - Steals: %lu\n", threadCount, rate, rate / singleThreadRate, 100.0 * rate / singleThreadRate / (double)threadCount, steals);
+    }
+  }
+
   // If saving hash, do it now
   if (hashOutputFile != "") jaffarCommon::file::saveStringToFile(std::string(hashStringBuffer), hashOutputFile.c_str());
 
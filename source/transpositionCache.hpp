@@ -0,0 +1,184 @@
+#pragma once
+
+// Transposition cache: (state hash, input) -> successor state memoization
+
+#include "inputParser.hpp"
+#include "nesInstanceBase.hpp"
+#include <algorithm>
+#include <atomic>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Optional, bounded and thread-safe cache layer around advanceState. Entries are keyed on the
+// hash of the serialized state plus the input applied to it, and store the serialized successor.
+// A hit loads the stored successor and skips emulation entirely.
+//
+// The cache is only exact when the serialized state covers everything the emulation depends on.
+// With state blocks disabled, a hit leaves the non-serialized parts of the emulator untouched.
+// Rendering is skipped on hits too, so it is intended for headless search.
+class TranspositionCache
+{
+  public:
+  TranspositionCache(const size_t maxEntries, const size_t stateSize, const size_t shardCount = 64)
+    : _stateSize(stateSize),
+      _shardCount(shardCount),
+      _shardCapacity((maxEntries + shardCount - 1) / shardCount),
+      _shards(std::make_unique<shard_t[]>(shardCount))
+  {
+    if (_shardCapacity == 0) JAFFAR_THROW_LOGIC("Transposition cache requires at least one entry\n");
+  }
+
+  // Advances the instance by one input, serving the successor from the cache whenever the (state, input) pair was seen before.
+  // The scratch buffer must be able to hold a full serialized state, and belongs to the calling thread.
+  inline void advanceState(NESInstanceBase &instance, const jaffar::input_t &input, uint8_t *scratch)
+  {
+    // Getting key from the current state and the input to apply
+    {
+      jaffarCommon::serializer::Contiguous s(scratch, _stateSize);
+      instance.serializeState(s);
+    }
+    const auto key = getKey(scratch, input);
+
+    // On hit, load the successor directly
+    if (lookup(key, scratch) == true)
+    {
+      jaffarCommon::deserializer::Contiguous d(scratch, _stateSize);
+      instance.deserializeState(d);
+      return;
+    }
+
+    // On miss, emulate and store the result
+    instance.advanceState(input);
+    {
+      jaffarCommon::serializer::Contiguous s(scratch, _stateSize);
+      instance.serializeState(s);
+    }
+    insert(key, scratch);
+  }
+
+  inline size_t getHitCount() const { return _hits.load(); }
+  inline size_t getMissCount() const { return _misses.load(); }
+  inline size_t getEvictionCount() const { return _evictions.load(); }
+
+  inline double getHitRate() const
+  {
+    const size_t total = getHitCount() + getMissCount();
+    return total == 0 ? 0.0 : (double)getHitCount() / (double)total;
+  }
+
+  inline size_t getEntryCount() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+      std::lock_guard<std::mutex> lock(_shards[i].mutex);
+      count += _shards[i].index.size();
+    }
+    return count;
+  }
+
+  // Bytes used by the stored successor states and their keys
+  inline size_t getMemoryUsage() const
+  {
+    size_t bytes = 0;
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+      std::lock_guard<std::mutex> lock(_shards[i].mutex);
+      bytes += _shards[i].storage.size() + _shards[i].keys.size() * sizeof(jaffarCommon::hash::hash_t);
+      bytes += _shards[i].index.size() * (sizeof(jaffarCommon::hash::hash_t) + sizeof(size_t));
+    }
+    return bytes;
+  }
+
+  private:
+  struct keyHasher_t
+  {
+    inline size_t operator()(const jaffarCommon::hash::hash_t &key) const { return key.first ^ key.second; }
+  };
+
+  struct shard_t
+  {
+    mutable std::mutex mutex;
+    std::unordered_map<jaffarCommon::hash::hash_t, size_t, keyHasher_t> index;
+    std::vector<jaffarCommon::hash::hash_t> keys;
+    std::vector<uint8_t> storage;
+    size_t nextSlot = 0;
+  };
+
+  inline jaffarCommon::hash::hash_t getKey(const uint8_t *state, const jaffar::input_t &input) const
+  {
+    const auto stateHash = jaffarCommon::hash::calculateMetroHash(state, _stateSize);
+
+    uint64_t keyData[6];
+    keyData[0] = stateHash.first;
+    keyData[1] = stateHash.second;
+    keyData[2] = ((uint64_t)input.port2 << 32) | input.port1;
+    keyData[3] = input.arkanoidLatch;
+    keyData[4] = input.arkanoidFire;
+    keyData[5] = (input.power ? 1 : 0) | (input.reset ? 2 : 0);
+    return jaffarCommon::hash::calculateMetroHash(keyData, sizeof(keyData));
+  }
+
+  inline shard_t &getShard(const jaffarCommon::hash::hash_t &key) const { return _shards[key.first % _shardCount]; }
+
+  inline bool lookup(const jaffarCommon::hash::hash_t &key, uint8_t *output)
+  {
+    auto &shard = getShard(key);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it != shard.index.end())
+      {
+        memcpy(output, &shard.storage[it->second * _stateSize], _stateSize);
+        _hits++;
+        return true;
+      }
+    }
+    _misses++;
+    return false;
+  }
+
+  inline void insert(const jaffarCommon::hash::hash_t &key, const uint8_t *state)
+  {
+    auto &shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Another thread may have stored the same successor meanwhile
+    if (shard.index.find(key) != shard.index.end()) return;
+
+    // Slots are recycled in insertion order once the shard is full
+    const size_t slot = shard.nextSlot;
+
+    // Shard storage grows on demand, and never past its capacity
+    if (slot == shard.keys.size())
+    {
+      const size_t slotCount = std::min(_shardCapacity, std::max((size_t)16, 2 * shard.keys.size()));
+      shard.storage.resize(slotCount * _stateSize);
+      shard.keys.resize(slotCount);
+    }
+    shard.nextSlot = (shard.nextSlot + 1) % _shardCapacity;
+    if (shard.index.size() == _shardCapacity)
+    {
+      shard.index.erase(shard.keys[slot]);
+      _evictions++;
+    }
+
+    shard.keys[slot] = key;
+    memcpy(&shard.storage[slot * _stateSize], state, _stateSize);
+    shard.index[key] = slot;
+  }
+
+  const size_t _stateSize;
+  const size_t _shardCount;
+  const size_t _shardCapacity;
+  std::unique_ptr<shard_t[]> _shards;
+
+  std::atomic<size_t> _hits = 0;
+  std::atomic<size_t> _misses = 0;
+  std::atomic<size_t> _evictions = 0;
+};